@@ -0,0 +1,45 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include<atomic>
+#include<cstdlib>
+#include<new>
+
+// Counts every global operator new call so benchmarks can report heap
+// allocations per operation. Replaces the global allocation functions, so
+// include it from the single source file of a program only. The operators
+// stay out of line so the compiler does not pair an inlined malloc()
+// or free() with the other side and warn about a mismatch.
+inline std::atomic<size_t> allocationCount{0};
+
+inline size_t AllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#endif
@@ -3,17 +3,234 @@
 #include<unordered_map>
 #include<unordered_set>
 #include<stack>
+#include<string>
+#include<chrono>
+#include<random>
+#include<algorithm>
+#include<cstdint>
 
 using namespace std;
 
 
 typedef unordered_map<int, unordered_map<char, int>> TransitionTable;
 
+// Regular expression as an index into a RegexPool
+typedef int Regex;
+
+enum RegexKind : uint8_t { RE_EMPTY, RE_EPSILON, RE_SYMBOL, RE_CONCAT, RE_UNION, RE_STAR };
+
+struct RegexNode {
+    RegexKind kind;
+    char symbol;        // RE_SYMBOL only
+    Regex left, right;  // Operands, -1 when unused
+    size_t length;      // Chars of the printed form, saturated
+
+    bool operator==(const RegexNode& o) const {
+        return kind == o.kind && symbol == o.symbol && left == o.left && right == o.right;
+    }
+};
+
+struct RegexNodeHash {
+    size_t operator()(const RegexNode& n) const {
+        uint64_t h = ((uint64_t) n.kind << 8) | (unsigned char) n.symbol;
+        h = h * 0x9E3779B97F4A7C15ULL ^ (uint32_t) n.left;
+        h = h * 0x9E3779B97F4A7C15ULL ^ (uint32_t) n.right;
+        return h ^ (h >> 29);
+    }
+};
+
+// Hash-consed regex DAG. Every distinct node is stored once and referred to
+// by index, so equal subexpressions are shared, equality is an int compare
+// and substituting an expression copies nothing. The constructors simplify
+// as they build:
+//   Concat: ∅r = r∅ = ∅, εr = rε = r, kept right-nested
+//   Union:  ∅|r = r, operands flattened, sorted and deduplicated, ε dropped
+//           next to a starred operand
+//   Star:   ∅* = ε* = ε, (r*)* = r*, (ε|r)* = r*
+// Only ToString expands the DAG into text.
+class RegexPool {
+    vector<RegexNode> nodes;
+    unordered_map<RegexNode, Regex, RegexNodeHash> index;
+
+    static size_t Add(size_t a, size_t b) {
+        return (a > SIZE_MAX - b) ? SIZE_MAX : a + b;
+    }
+
+    Regex Make(RegexKind kind, char symbol, Regex left, Regex right) {
+        RegexNode n{kind, symbol, left, right, 0};
+        auto it = index.find(n);
+        if (it != index.end()) return it->second;
+
+        switch (kind) {
+            case RE_EMPTY:   n.length = 3; break;    // "∅" in UTF-8
+            case RE_EPSILON: n.length = 2; break;    // "ε"
+            case RE_SYMBOL:  n.length = 1; break;
+            case RE_CONCAT:
+                n.length = Add(Parenthesized(left), Parenthesized(right));
+                break;
+            case RE_UNION:
+                n.length = Add(Add(nodes[left].length, nodes[right].length), 1);
+                break;
+            case RE_STAR:
+                n.length = Add(nodes[left].length, (nodes[left].kind == RE_SYMBOL) ? 1 : 3);
+                break;
+        }
+        nodes.push_back(n);
+        index.insert({n, (Regex) nodes.size() - 1});
+        return nodes.size() - 1;
+    }
+
+    // Length of r as a concatenation operand, unions need parentheses
+    size_t Parenthesized(Regex r) const {
+        return Add(nodes[r].length, (nodes[r].kind == RE_UNION) ? 2 : 0);
+    }
+
+    // Operands of a union chain, or r itself
+    void UnionOperands(Regex r, vector<Regex>& ops) const {
+        while (nodes[r].kind == RE_UNION) {
+            ops.push_back(nodes[r].left);
+            r = nodes[r].right;
+        }
+        ops.push_back(r);
+    }
+
+    void Print(Regex r, string& out) const {
+        // Concatenations and unions are walked along their right spine, so
+        // only nested parentheses recurse
+        while (true) {
+            const RegexNode& n = nodes[r];
+            switch (n.kind) {
+                case RE_EMPTY:   out += "∅"; return;
+                case RE_EPSILON: out += "ε"; return;
+                case RE_SYMBOL:  out += n.symbol; return;
+                case RE_STAR:
+                    if (nodes[n.left].kind == RE_SYMBOL) {
+                        out += nodes[n.left].symbol;
+                    }
+                    else {
+                        out += "(";
+                        Print(n.left, out);
+                        out += ")";
+                    }
+                    out += "*";
+                    return;
+                case RE_UNION:
+                    Print(n.left, out);
+                    out += "|";
+                    r = n.right;
+                    break;
+                case RE_CONCAT:
+                    PrintOperand(n.left, out);
+                    if (nodes[n.right].kind == RE_UNION) {
+                        PrintOperand(n.right, out);
+                        return;
+                    }
+                    r = n.right;
+                    break;
+            }
+        }
+    }
+
+    void PrintOperand(Regex r, string& out) const {
+        if (nodes[r].kind == RE_UNION) {
+            out += "(";
+            Print(r, out);
+            out += ")";
+        }
+        else {
+            Print(r, out);
+        }
+    }
+
+public:
+    constexpr static Regex EMPTY = 0;
+    constexpr static Regex EPSILON = 1;
+
+    RegexPool() {
+        Make(RE_EMPTY, '\0', -1, -1);
+        Make(RE_EPSILON, '\0', -1, -1);
+    }
+
+    Regex Symbol(char c) {
+        return Make(RE_SYMBOL, c, -1, -1);
+    }
+
+    Regex Concat(Regex a, Regex b) {
+        if (a == EMPTY || b == EMPTY) return EMPTY;
+        if (a == EPSILON) return b;
+        if (b == EPSILON) return a;
+
+        // (xy)b is stored as x(yb)
+        vector<Regex> chain;
+        while (nodes[a].kind == RE_CONCAT) {
+            chain.push_back(nodes[a].left);
+            a = nodes[a].right;
+        }
+        Regex r = Make(RE_CONCAT, '\0', a, b);
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            r = Make(RE_CONCAT, '\0', *it, r);
+        }
+        return r;
+    }
+
+    Regex Union(Regex a, Regex b) {
+        if (a == EMPTY || a == b) return b;
+        if (b == EMPTY) return a;
+
+        vector<Regex> ops;
+        UnionOperands(a, ops);
+        UnionOperands(b, ops);
+        sort(ops.begin(), ops.end());
+        ops.erase(unique(ops.begin(), ops.end()), ops.end());
+
+        // ε is already in any r*
+        if (ops[0] == EPSILON) {
+            for (Regex op : ops) {
+                if (nodes[op].kind == RE_STAR) {
+                    ops.erase(ops.begin());
+                    break;
+                }
+            }
+        }
+
+        Regex r = ops.back();
+        for (int i = (int) ops.size() - 2; i >= 0; i--) {
+            r = Make(RE_UNION, '\0', ops[i], r);
+        }
+        return r;
+    }
+
+    Regex Star(Regex a) {
+        if (a == EMPTY || a == EPSILON) return EPSILON;
+        if (nodes[a].kind == RE_STAR) return a;
+
+        // (ε|r)* = r*, the union is sorted so ε comes first
+        if (nodes[a].kind == RE_UNION && nodes[a].left == EPSILON) {
+            return Star(nodes[a].right);
+        }
+        return Make(RE_STAR, '\0', a, -1);
+    }
+
+    string ToString(Regex r) const {
+        string out;
+        out.reserve(min(nodes[r].length, (size_t) 1 << 20));
+        Print(r, out);
+        return out;
+    }
+
+    // Printed length of r, without printing it
+    size_t Length(Regex r) const { return nodes[r].length; }
+
+    // Distinct subexpressions stored so far
+    size_t Size() const { return nodes.size(); }
+};
+
+
 struct Operand {
     int state;
-    string re;
+    Regex re;
 
-    Operand(int s = 0, string re = ""): state(s), re(re)  {}
+    Operand(int s = 0, Regex re = RegexPool::EPSILON): state(s), re(re)  {}
 };
 
 
@@ -36,13 +253,13 @@ void DisplayTransitionTable(const TransitionTable& t) {
     cout << endl;
 }
 
-void DisplayEqns(const unordered_map<int, Eqn>& eqns) {
+void DisplayEqns(const unordered_map<int, Eqn>& eqns, const RegexPool& pool) {
     cout << "Equations:\n";
     for (const auto& e : eqns) {
         cout << "Eqn for State " << e.first << ": ";
         for (size_t i = 0; i < e.second._val.size(); i++) {
             const Operand& op = e.second._val[i];
-            cout << "(" << op.state << ", " << op.re << ")" << "+";
+            cout << "(" << op.state << ", " << pool.ToString(op.re) << ")" << "+";
         }
         cout << endl;
     }
@@ -50,7 +267,7 @@ void DisplayEqns(const unordered_map<int, Eqn>& eqns) {
 }
 
 
-unordered_map<int, Eqn> GenerateEqns(TransitionTable t) {
+unordered_map<int, Eqn> GenerateEqns(TransitionTable t, RegexPool& pool, bool display = true) {
     unordered_map<int, Eqn> eqns;
 
     // Insert all the States of Transition Table as Keys for Eqns
@@ -64,23 +281,25 @@ unordered_map<int, Eqn> GenerateEqns(TransitionTable t) {
         for (auto links : p.second) {
             int node = links.second;
             char c = links.first;
-            eqns[node]._val.push_back(Operand(curr, string(1,c) ) );
+            eqns[node]._val.push_back(Operand(curr, pool.Symbol(c) ) );
         }
     }
 
-    DisplayEqns(eqns);
+    if (display) {
+        DisplayEqns(eqns, pool);
+    }
 
 
     return eqns;
 }
 
-Eqn MergeSameStates(Eqn& eqn) {
-    unordered_map<int, string> merged;
+Eqn MergeSameStates(Eqn& eqn, RegexPool& pool) {
+    unordered_map<int, Regex> merged;
     
     // Collect all REs for each state
     for (auto op : eqn._val) {
         if (merged.find(op.state) != merged.end() ) {
-            merged[op.state] += ("|" + op.re);
+            merged[op.state] = pool.Union(merged[op.state], op.re);
         }
         else {
             merged[op.state] = op.re;
@@ -96,112 +315,279 @@ Eqn MergeSameStates(Eqn& eqn) {
     return newEq;
 }
 
-Eqn _Solve(unordered_map<int, Eqn>& eqns, int idx, unordered_set<int>& _visitedStates) {
+// Solves the Eqn of state idx in terms of the states still being solved
+// further up the recursion (visited but not solved) and the start term,
+// state -1. An operand (p, re) stands for X_p re, so substituting
+// X_p = X_r o.re gives X_r o.re re.
+Eqn _Solve(unordered_map<int, Eqn>& eqns, int idx, unordered_set<int>& _visitedStates,
+           unordered_set<int>& _solvedStates, RegexPool& pool) {
     // Add the Current State in Vistied State
     _visitedStates.insert(idx);
     
     // cout << "\n=== Solving State " << idx << " ===\n";
     // cout << "Initial operands: " << eqns[idx]._val.size() << endl;
         
-    // Check all the Oparends of the State Eqn
-    for (int i = 0; i < eqns[idx]._val.size(); i++ ) {
-        Operand op = eqns[idx]._val[i];
-        
-        // cout << "   Evaluating Operand -> (State: " << op.state << ", RE: " << op.re << ")" << endl;
-        // If Operand State Different from curr State and not previously visited goto that Eqn
-        if (op.state != idx && _visitedStates.find(op.state) == _visitedStates.end() ) {
-            // cout << "   --> Jumping to State " << op.state << endl;
-
-            Eqn nEq = _Solve(eqns, op.state, _visitedStates);
-            
-            // cout << "   --> Returned from State " << op.state << " with " << nEq._val.size() << " operands\n";
-            
-            // Merge the Newly genrated Eqn into the current State
-            // Distribute Curr State RE onto the RE of all operands of the Solved Eqn
-            for (auto& o : nEq._val) {
-                o.re = op.re + o.re;
-                eqns[idx]._val.push_back(o);
+    // Replace every Operand whose State is solved, or can be solved now, by
+    // that State's Eqn. A solved Eqn only refers to States that were further
+    // up when it was solved, so the substitutions run out.
+    bool substituted = true;
+    while (substituted) {
+        substituted = false;
+        for (int i = 0; i < eqns[idx]._val.size(); i++ ) {
+            Operand op = eqns[idx]._val[i];
+            if (op.state == idx || op.state == -1) continue;
+
+            // cout << "   Evaluating Operand -> (State: " << op.state << ")" << endl;
+            if (_visitedStates.find(op.state) == _visitedStates.end() ) {
+                _Solve(eqns, op.state, _visitedStates, _solvedStates, pool);
             }
+            // Still being solved further up, Arden's rule resolves it there
+            if (_solvedStates.find(op.state) == _solvedStates.end() ) continue;
 
-            // remove Previous Instance of Operand and add nEq values in currState Eqn
-            eqns[idx]._val.erase(eqns[idx]._val.begin() + i);    
-            i--;  // Decrementing i so that we donot skip a Operand after deletion
-            
-            // Simplify the States
-            eqns[idx] = MergeSameStates(eqns[idx]);
-            
-            // cout << "   --> After merge, State " << idx << " has " << eqns[idx]._val.size() << " operands\n";
-        }        
-        
+            // Distribute the Operand RE onto the end of the solved Eqn's operands
+            eqns[idx]._val.erase(eqns[idx]._val.begin() + i);
+            for (const Operand& o : eqns[op.state]._val) {
+                eqns[idx]._val.push_back(Operand(o.state, pool.Concat(o.re, op.re)));
+            }
+
+            // Simplify the States, merging reorders them so scan again
+            eqns[idx] = MergeSameStates(eqns[idx], pool);
+            substituted = true;
+            break;
+        }
     }
 
+    // One operand per State, so a self loop on several chars is one P
+    eqns[idx] = MergeSameStates(eqns[idx], pool);
+
     // Check if in Form Q + RP convert to QP*
     bool recurringCall = false;
     int i = 0;
     for (i = 0; i < eqns[idx]._val.size(); i++) {
         if (eqns[idx]._val[i].state == idx) {
             recurringCall = true;
-            // cout << "   Found self-loop at operand " << i << " with RE: " << eqns[idx]._val[i].re << endl;
             break;
         }
     }
 
     if (recurringCall) {
         // Remove Old Operand and Store the RE
-        string P = eqns[idx]._val[i].re;
+        Regex P = eqns[idx]._val[i].re;
         eqns[idx]._val.erase(eqns[idx]._val.begin() + i);
         
-        // cout << "   Applying Arden's rule with P = " << P << endl;
-        
-        // If there are other operands (Q), apply QP*
-        if (eqns[idx]._val.size() > 0) {
-            for (auto& op : eqns[idx]._val) {
-                op.re = op.re + "(" + P + ")*";
-            }
+        // Apply QP* to the other operands (Q). Without any, R = RP only
+        // has the empty solution and the Eqn stays empty.
+        for (auto& op : eqns[idx]._val) {
+            op.re = pool.Concat(op.re, pool.Star(P));
         }
-        // If no other operands, result is just P* (with epsilon)
-        else {
-            eqns[idx]._val.push_back(Operand(-1, "(" + P + ")*"));
-        }
-        
-        // cout << "   After Arden's rule, State " << idx << " has " << eqns[idx]._val.size() << " operands\n";
     }
 
-    // cout<<"Eqn Scanning Completed for State " << idx << "...\n";
-    // Now Check if Recursive Property exists for curr State (R = Q + RP) -> R = QP*
-
+    _solvedStates.insert(idx);
     return eqns[idx];
 }
 
-string EvaluateRE(const TransitionTable t, int finalState) {
+// Solved expression for finalState, as a node of 'pool'
+Regex SolveRE(const TransitionTable& t, int finalState, RegexPool& pool, bool display = true) {
     // Generate Eqns
-    unordered_map<int, Eqn> eqns = GenerateEqns(t);
-    unordered_set<int> _visited;
+    unordered_map<int, Eqn> eqns = GenerateEqns(t, pool, display);
+    unordered_set<int> _visited, _solved;
 
-    Eqn ans = _Solve(eqns, finalState, _visited);
+    // The final State is also the start State, the empty string reaches it
+    eqns[finalState]._val.push_back(Operand(-1, RegexPool::EPSILON));
+
+    Eqn ans = _Solve(eqns, finalState, _visited, _solved, pool);
     
     // Debug: Display the final equation
     // cout << "\nFinal Equation for State " << finalState << ":\n";
     // for (int i = 0; i < ans._val.size(); i++) {
     //     cout << "   Operand " << i << ": State=" << ans._val[i].state 
-    //          << ", RE=\"" << ans._val[i].re << "\"\n";
+    //          << ", RE=\"" << pool.ToString(ans._val[i].re) << "\"\n";
     // }
     
-    // Build the Final RE String from the Solved Eqn
-    string result = "";
+    // Union of the Operands of the Solved Eqn, all start terms by now
+    Regex result = RegexPool::EMPTY;
     for (int i = 0; i < ans._val.size(); i++) {
-        result += ans._val[i].re;
-        if (i < ans._val.size() - 1) {
-            result += "|";
-        }
+        result = pool.Union(result, ans._val[i].re);
     }
 
     return result;
 }
 
+string EvaluateRE(const TransitionTable t, int finalState, bool display = true) {
+    RegexPool pool;
+    return pool.ToString(SolveRE(t, finalState, pool, display));
+}
+
 
+// Regular expression for the strings leading from startState to
+// finalState, by state elimination. The DFA becomes a graph with one
+// expression per edge in an adjacency matrix, plus a new source S and sink F
+// joined to the start and final state by ε edges. States are removed one at
+// a time, each predecessor-successor pair a -> q -> b being rerouted as
+// a -> b labelled (a,q)(q,q)*(q,b), until only S -> F remains. A missing
+// edge is labelled ∅.
+//
+// The order decides how large the result gets. Removing a state with i
+// predecessors and o successors adds up to i * o edges, so the state with
+// the lowest in-degree x out-degree goes first.
+Regex EliminateStates(const TransitionTable& t, int startState, int finalState, RegexPool& pool) {
+    // Dense numbering of every state that appears as a source or a target
+    unordered_map<int, int> idx;
+    auto number = [&](int s) { idx.insert({s, (int) idx.size()}); };
+    number(startState);
+    number(finalState);
+    for (const auto& p : t) {
+        number(p.first);
+        for (const auto& link : p.second) number(link.second);
+    }
+
+    int n = idx.size();
+    int S = n, F = n + 1, N = n + 2;
+    vector<Regex> label((size_t) N * N, RegexPool::EMPTY);
+    vector<int> in(N, 0), out(N, 0);    // Edges from and to other states
+    vector<size_t> weight(N, 0);        // Printed expression chars on a state's edges
+
+    auto addEdge = [&](int a, int b, Regex re) {
+        size_t e = (size_t) a * N + b;
+        Regex before = label[e];
+        if (before == RegexPool::EMPTY && a != b) {
+            out[a]++;
+            in[b]++;
+        }
+        label[e] = pool.Union(before, re);
+        size_t grown = pool.Length(label[e]) - (before == RegexPool::EMPTY ? 0 : pool.Length(before));
+        weight[a] += grown;
+        if (a != b) weight[b] += grown;
+    };
+
+    for (const auto& p : t) {
+        for (const auto& link : p.second) {
+            addEdge(idx[p.first], idx[link.second], pool.Symbol(link.first));
+        }
+    }
+    addEdge(S, idx[startState], RegexPool::EPSILON);
+    addEdge(idx[finalState], F, RegexPool::EPSILON);
+
+    vector<char> alive(N, 1);
+    vector<int> preds, succs;
+    for (int step = 0; step < n; step++) {
+        // Ties, common on regular graphs, go to the state with the shortest
+        // expressions around it
+        int q = -1;
+        long long best = 0;
+        for (int s = 0; s < n; s++) {
+            long long cost = (long long) in[s] * out[s];
+            if (alive[s] && (q == -1 || cost < best || (cost == best && weight[s] < weight[q]))) {
+                q = s;
+                best = cost;
+            }
+        }
+        alive[q] = 0;
+
+        preds.clear();
+        succs.clear();
+        for (int a = 0; a < N; a++) {
+            if (alive[a] && label[(size_t) a * N + q] != RegexPool::EMPTY) preds.push_back(a);
+            if (alive[a] && label[(size_t) q * N + a] != RegexPool::EMPTY) succs.push_back(a);
+        }
+
+        size_t self = (size_t) q * N + q;
+        Regex loop = pool.Star(label[self]);
+        for (int a : preds) {
+            Regex head = pool.Concat(label[(size_t) a * N + q], loop);
+            for (int b : succs) {
+                addEdge(a, b, pool.Concat(head, label[(size_t) q * N + b]));
+            }
+        }
+
+        // Drop q's edges, their expressions now live in the new ones
+        for (int a : preds) {
+            size_t e = (size_t) a * N + q;
+            weight[a] -= pool.Length(label[e]);
+            label[e] = RegexPool::EMPTY;
+            out[a]--;
+        }
+        for (int b : succs) {
+            size_t e = (size_t) q * N + b;
+            weight[b] -= pool.Length(label[e]);
+            label[e] = RegexPool::EMPTY;
+            in[b]--;
+        }
+        label[self] = RegexPool::EMPTY;
+    }
+
+    return label[(size_t) S * N + F];
+}
+
+
+// Complete DFA over {0, 1}. With band 0 both targets are random. Otherwise
+// '0' steps around a ring of all states and '1' jumps at most 'band' states
+// either way, a narrow state graph like most hand-written machines.
+TransitionTable RandomDFA(int states, int band, mt19937& rng) {
+    TransitionTable t;
+    for (int s = 0; s < states; s++) {
+        if (band == 0) {
+            t[s]['0'] = rng() % states;
+            t[s]['1'] = rng() % states;
+        }
+        else {
+            t[s]['0'] = (s + 1) % states;
+            t[s]['1'] = (s + (int) (rng() % (2 * band + 1)) - band + states) % states;
+        }
+    }
+    return t;
+}
+
+// Both solvers on the same random DFAs, with state 0 as start and final
+// state since EvaluateRE assumes they coincide. The printed expression of
+// a fully random DFA grows exponentially with any elimination order, the
+// shared DAG does not. EvaluateRE is dropped from a sweep once it takes more
+// than a second.
+void RunBenchmarks() {
+    mt19937 rng(1);
+
+    for (int band : {0, 2}) {
+        vector<int> sizes = (band == 0) ? vector<int>{4, 8, 16, 24, 32, 48, 64, 96, 128}
+                                        : vector<int>{16, 32, 64, 128, 256, 512};
+        bool runArden = true;
+
+        cout << "\nRandom DFAs, 2 symbols, " << (band == 0 ? string("any target") : "band " + to_string(band)) << "\n";
+        cout << "=========================================\n";
+        for (int n : sizes) {
+            TransitionTable t = RandomDFA(n, band, rng);
+
+            // Lengths are those of the printed expressions, which are never
+            // built here; nodes are the distinct subexpressions stored.
+            // Elimination runs first, freeing EvaluateRE's far larger pool
+            // would otherwise bill the allocator's cleanup to it.
+            RegexPool elimPool;
+            auto t0 = chrono::steady_clock::now();
+            Regex elim = EliminateStates(t, 0, 0, elimPool);
+            double elimMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+            cout << n << " states : ";
+            if (runArden) {
+                RegexPool pool;
+                auto t1 = chrono::steady_clock::now();
+                Regex re = SolveRE(t, 0, pool, false);
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t1).count();
+                cout << "EvaluateRE " << ms << " ms (" << pool.Length(re) << " chars, "
+                     << pool.Size() << " nodes) | ";
+                if (ms > 1000) runArden = false;
+            }
+            cout << "EliminateStates " << elimMs << " ms (" << elimPool.Length(elim) << " chars, "
+                 << elimPool.Size() << " nodes)" << endl;
+        }
+    }
+}
+
+
+int main (int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        RunBenchmarks();
+        return 0;
+    }
 
-int main () {
     // Creating the Transition table
     TransitionTable t;
     t.insert({1, unordered_map<char, int>() });
@@ -226,5 +612,10 @@ int main () {
     cout<<"Final Regular Expression: "<<RE<<endl;
     cout<<"========================================\n";
 
+    // Same language by state elimination, the final state is also the start
+    RegexPool pool;
+    Regex eliminated = EliminateStates(t, FinalState, FinalState, pool);
+    cout<<"State Elimination:        "<<pool.ToString(eliminated)<<endl;
+
     return 0;
 }
\ No newline at end of file
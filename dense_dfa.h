@@ -0,0 +1,410 @@
+#ifndef DENSE_DFA_H
+#define DENSE_DFA_H
+
+#include<vector>
+#include<array>
+#include<queue>
+#include<algorithm>
+#include<map>
+#include<string>
+#include<iostream>
+#include<string_view>
+#include<stdexcept>
+#include<cstdint>
+#include "mapped_image.h"
+
+// Complete DFA over symbols 0 .. nSymbols-1 stored as one flat table:
+// table[state * nSymbols + symbol] = next state
+struct DenseDFA {
+    int nStates;
+    int nSymbols;
+    int start;
+    std::vector<int> table;
+    std::vector<bool> accepting;
+
+    DenseDFA(int states = 0, int symbols = 0, int startState = 0)
+        : nStates(states), nSymbols(symbols), start(startState),
+          table(states * symbols, 0), accepting(states, false) {}
+
+    int Next(int state, int symbol) const {
+        return table[state * nSymbols + symbol];
+    }
+};
+
+// DenseDFA plus the column of every input byte, so raw bytes can be run
+// without a per-char lookup in the automaton's own alphabet maps
+struct ByteDFA {
+    DenseDFA dfa;
+    std::array<int, 256> byteClass;
+
+    int Run(const char* data, size_t len, int state) const {
+        const int* table = dfa.table.data();
+        int k = dfa.nSymbols;
+        for (size_t i = 0; i < len; i++) {
+            state = table[state * k + byteClass[(unsigned char) data[i]]];
+        }
+        return state;
+    }
+};
+
+// Text form of a ByteDFA, as written by the programs' --dump option:
+//   bytedfa <states> <symbols> <start>
+//   <256 byte classes>
+//   <0/1 accepting flag per state>
+//   <one row of 'symbols' targets per state>
+inline void WriteByteDFA(std::ostream& out, const ByteDFA& b) {
+    out << "bytedfa " << b.dfa.nStates << " " << b.dfa.nSymbols << " " << b.dfa.start << "\n";
+    for (int c = 0; c < 256; c++) {
+        out << b.byteClass[c] << ((c % 32 == 31) ? "\n" : " ");
+    }
+    for (int s = 0; s < b.dfa.nStates; s++) {
+        out << b.dfa.accepting[s] << ((s + 1 == b.dfa.nStates) ? "\n" : " ");
+    }
+    for (int s = 0; s < b.dfa.nStates; s++) {
+        for (int a = 0; a < b.dfa.nSymbols; a++) {
+            out << b.dfa.Next(s, a) << ((a + 1 == b.dfa.nSymbols) ? "\n" : " ");
+        }
+    }
+}
+
+// Returns false on malformed input or out of range entries
+inline bool ReadByteDFA(std::istream& in, ByteDFA& b) {
+    std::string tag;
+    int states, symbols, start;
+    if (!(in >> tag >> states >> symbols >> start) || tag != "bytedfa") return false;
+    if (states < 1 || symbols < 1 || start < 0 || start >= states) return false;
+
+    b.dfa = DenseDFA(states, symbols, start);
+    for (int c = 0; c < 256; c++) {
+        if (!(in >> b.byteClass[c]) || b.byteClass[c] < 0 || b.byteClass[c] >= symbols) return false;
+    }
+    for (int s = 0; s < states; s++) {
+        int flag;
+        if (!(in >> flag)) return false;
+        b.dfa.accepting[s] = flag;
+    }
+    for (int& t : b.dfa.table) {
+        if (!(in >> t) || t < 0 || t >= states) return false;
+    }
+    return true;
+}
+
+// Binary image of a ByteDFA (see mapped_image.h): the 256 byte classes, the
+// table in the narrowest cell type that holds every state number, and one
+// accepting flag per state. Read back in place with ByteDFAView.
+inline bool WriteByteDFAImage(std::ostream& out, const ByteDFA& b) {
+    const DenseDFA& dfa = b.dfa;
+    int cellBytes = (dfa.nStates <= 256) ? 1 : (dfa.nStates <= 65536) ? 2 : 4;
+
+    std::vector<uint8_t> cells8;
+    std::vector<uint16_t> cells16;
+    std::vector<uint32_t> cells32;
+    const void* cells;
+    if (cellBytes == 1) {
+        cells8.assign(dfa.table.begin(), dfa.table.end());
+        cells = cells8.data();
+    }
+    else if (cellBytes == 2) {
+        cells16.assign(dfa.table.begin(), dfa.table.end());
+        cells = cells16.data();
+    }
+    else {
+        cells32.assign(dfa.table.begin(), dfa.table.end());
+        cells = cells32.data();
+    }
+    std::vector<int32_t> classes(b.byteClass.begin(), b.byteClass.end());
+    std::vector<uint8_t> accepting(dfa.accepting.begin(), dfa.accepting.end());
+
+    ImageWriter w(IMAGE_BYTE_DFA);
+    w.SetParam(0, dfa.nStates);
+    w.SetParam(1, dfa.nSymbols);
+    w.SetParam(2, dfa.start);
+    w.SetParam(3, cellBytes);
+    w.AddSection(classes.data(), classes.size() * sizeof(int32_t));
+    w.AddSection(cells, dfa.table.size() * cellBytes);
+    w.AddSection(accepting.data(), accepting.size());
+    return w.Write(out);
+}
+
+// Runs a ByteDFA image where it lies, typically MappedFile::data(), so a
+// compiled automaton loads without being rebuilt or copied. The image must
+// outlive the view. Loading reads the table once to check every target.
+class ByteDFAView {
+    int nStates, nSymbols, start, cellBytes;
+    const int32_t* byteClass;
+    const void* cells;
+    const uint8_t* accepting;
+
+    template<class Cell>
+    int RunCells(const Cell* table, const unsigned char* in, size_t len, int state) const {
+        for (size_t i = 0; i < len; i++) {
+            state = table[(size_t) state * nSymbols + byteClass[in[i]]];
+        }
+        return state;
+    }
+
+    template<class Cell>
+    bool CellsInRange(const Cell* table, size_t count) const {
+        for (size_t i = 0; i < count; i++) {
+            if (table[i] >= (uint32_t) nStates) return false;
+        }
+        return true;
+    }
+
+public:
+    // Throws std::range_error on anything that is not a consistent ByteDFA
+    // image of this version
+    ByteDFAView(const void* image, size_t size) {
+        const ImageHeader* h = ReadImageHeader(image, size, IMAGE_BYTE_DFA, 3);
+        if (!h) throw std::range_error("Not a DFA image of this version");
+
+        const int64_t* p = h->params;
+        if (p[0] < 1 || p[0] > INT32_MAX || p[1] < 1 || p[1] > INT32_MAX || p[2] < 0 || p[2] >= p[0] ||
+            (p[3] != 1 && p[3] != 2 && p[3] != 4) || p[0] > ((int64_t) 1 << (8 * p[3]))) {
+            throw std::range_error("DFA image header out of range");
+        }
+        nStates = p[0];
+        nSymbols = p[1];
+        start = p[2];
+        cellBytes = p[3];
+
+        size_t classes, cellCount, flags;
+        byteClass = ImageSectionData<int32_t>(h, 0, classes);
+        cells = ImageSectionData<char>(h, 1, cellCount);
+        accepting = ImageSectionData<uint8_t>(h, 2, flags);
+        cellCount /= cellBytes;
+        if (classes != 256 || flags != (size_t) nStates || cellCount != (size_t) nStates * nSymbols) {
+            throw std::range_error("DFA image sections do not match its header");
+        }
+
+        for (int c = 0; c < 256; c++) {
+            if (byteClass[c] < 0 || byteClass[c] >= nSymbols) throw std::range_error("DFA image byte class out of range");
+        }
+        bool ok = (cellBytes == 1) ? CellsInRange((const uint8_t*) cells, cellCount)
+                : (cellBytes == 2) ? CellsInRange((const uint16_t*) cells, cellCount)
+                : CellsInRange((const uint32_t*) cells, cellCount);
+        if (!ok) throw std::range_error("DFA image transition out of range");
+    }
+
+    int States() const { return nStates; }
+    int Start() const { return start; }
+    bool Accepting(int state) const { return accepting[state]; }
+
+    int Run(const char* data, size_t len, int state) const {
+        const unsigned char* in = (const unsigned char*) data;
+        if (cellBytes == 1) return RunCells((const uint8_t*) cells, in, len, state);
+        if (cellBytes == 2) return RunCells((const uint16_t*) cells, in, len, state);
+        return RunCells((const uint32_t*) cells, in, len, state);
+    }
+
+    bool Accepts(std::string_view input) const {
+        return accepting[Run(input.data(), input.size(), start)];
+    }
+};
+
+// Same DFA with byte classes merged wherever two columns agree in every
+// state, so a 256-column table shrinks to the distinct behaviours. Columns
+// no byte maps to are dropped.
+inline ByteDFA MergeByteClasses(const ByteDFA& b) {
+    int n = b.dfa.nStates;
+    std::map<std::vector<int>, int> columnId;
+    std::vector<int> classOf(b.dfa.nSymbols, -1);
+    std::vector<std::vector<int>> columns;
+
+    ByteDFA out;
+    for (int c = 0; c < 256; c++) {
+        int a = b.byteClass[c];
+        if (classOf[a] == -1) {
+            std::vector<int> col(n);
+            for (int s = 0; s < n; s++) col[s] = b.dfa.Next(s, a);
+            auto it = columnId.find(col);
+            if (it == columnId.end()) {
+                it = columnId.insert({col, (int) columns.size()}).first;
+                columns.push_back(col);
+            }
+            classOf[a] = it->second;
+        }
+        out.byteClass[c] = classOf[a];
+    }
+
+    out.dfa = DenseDFA(n, columns.size(), b.dfa.start);
+    out.dfa.accepting = b.dfa.accepting;
+    for (int s = 0; s < n; s++) {
+        for (size_t a = 0; a < columns.size(); a++) {
+            out.dfa.table[s * columns.size() + a] = columns[a][s];
+        }
+    }
+    return out;
+}
+
+// Result of MinimizeDFA: the minimal DFA plus stateMap[oldState] = newState
+// (-1 for states unreachable from the start state)
+struct MinimizedDFA {
+    DenseDFA dfa;
+    std::vector<int> stateMap;
+};
+
+// Hopcroft partition refinement. Unreachable states are dropped first, then
+// blocks are split against the predecessors of a splitter block until the
+// partition is stable. Block numbering of the result follows BFS order from
+// the start state, so the minimal start state is always 0.
+//
+// The initial partition is accepting / non-accepting. Callers whose states
+// carry more than a bool (e.g. which patterns matched) pass stateClass, and
+// only states with equal class labels may be merged.
+inline MinimizedDFA MinimizeDFA(const DenseDFA& in, const std::vector<int>& stateClass = std::vector<int>()) {
+    int n = in.nStates;
+    int k = in.nSymbols;
+
+    // Reachable states from start
+    std::vector<int> reach;
+    std::vector<int> reachIdx(n, -1);
+    reachIdx[in.start] = 0;
+    reach.push_back(in.start);
+    for (size_t i = 0; i < reach.size(); i++) {
+        for (int a = 0; a < k; a++) {
+            int t = in.Next(reach[i], a);
+            if (reachIdx[t] == -1) {
+                reachIdx[t] = reach.size();
+                reach.push_back(t);
+            }
+        }
+    }
+    int m = reach.size();
+
+    // Inverse transitions in CSR form: predecessors of (state, symbol)
+    std::vector<int> predStart(m * k + 1, 0);
+    std::vector<int> preds(m * k);
+    for (int s = 0; s < m; s++) {
+        for (int a = 0; a < k; a++) {
+            predStart[reachIdx[in.Next(reach[s], a)] * k + a + 1]++;
+        }
+    }
+    for (int i = 0; i < m * k; i++) {
+        predStart[i + 1] += predStart[i];
+    }
+    std::vector<int> fillPos(predStart.begin(), predStart.end() - 1);
+    for (int s = 0; s < m; s++) {
+        for (int a = 0; a < k; a++) {
+            preds[fillPos[reachIdx[in.Next(reach[s], a)] * k + a]++] = s;
+        }
+    }
+
+    // Refinable partition: elems grouped by block, each block a range
+    std::vector<int> elems(m), pos(m), blockOf(m);
+    std::vector<int> bStart, bEnd, bMarked;
+    std::vector<bool> inWork;
+    std::vector<int> work;
+
+    // Initial partition: one block per class label
+    std::map<int, std::vector<int>> classes;
+    for (int s = 0; s < m; s++) {
+        int label = stateClass.empty() ? (int) in.accepting[reach[s]] : stateClass[reach[s]];
+        classes[label].push_back(s);
+    }
+    int idx = 0;
+    for (auto& c : classes) {
+        work.push_back(bStart.size());
+        bStart.push_back(idx);
+        for (int s : c.second) {
+            elems[idx] = s;
+            pos[s] = idx;
+            blockOf[s] = bStart.size() - 1;
+            idx++;
+        }
+        bEnd.push_back(idx);
+        bMarked.push_back(0);
+        inWork.push_back(true);
+    }
+
+    std::vector<int> touched;
+    std::vector<int> splitter;
+    while (!work.empty()) {
+        int b = work.back();
+        work.pop_back();
+        inWork[b] = false;
+
+        // Copy the splitter, splitting may reorder its range
+        splitter.assign(elems.begin() + bStart[b], elems.begin() + bEnd[b]);
+
+        for (int a = 0; a < k; a++) {
+            // Mark every predecessor by moving it to the front of its block
+            for (int t : splitter) {
+                for (int i = predStart[t * k + a]; i < predStart[t * k + a + 1]; i++) {
+                    int x = preds[i];
+                    int xb = blockOf[x];
+                    int dst = bStart[xb] + bMarked[xb];
+                    int other = elems[dst];
+                    std::swap(elems[pos[x]], elems[dst]);
+                    pos[other] = pos[x];
+                    pos[x] = dst;
+                    if (bMarked[xb]++ == 0) touched.push_back(xb);
+                }
+            }
+
+            // Split blocks that were only partially marked
+            for (int yb : touched) {
+                int marked = bMarked[yb];
+                bMarked[yb] = 0;
+                if (marked == bEnd[yb] - bStart[yb]) continue;
+
+                int nb = bStart.size();
+                bStart.push_back(bStart[yb]);
+                bEnd.push_back(bStart[yb] + marked);
+                bMarked.push_back(0);
+                inWork.push_back(false);
+                bStart[yb] += marked;
+                for (int i = bStart[nb]; i < bEnd[nb]; i++) {
+                    blockOf[elems[i]] = nb;
+                }
+
+                if (inWork[yb]) {
+                    work.push_back(nb);
+                    inWork[nb] = true;
+                }
+                else {
+                    int smaller = (marked <= bEnd[yb] - bStart[yb]) ? nb : yb;
+                    work.push_back(smaller);
+                    inWork[smaller] = true;
+                }
+            }
+            touched.clear();
+        }
+    }
+
+    // Number blocks in BFS order from the start state
+    int nBlocks = bStart.size();
+    std::vector<int> blockId(nBlocks, -1);
+    std::vector<int> order;
+    blockId[blockOf[0]] = 0;
+    order.push_back(blockOf[0]);
+    for (size_t i = 0; i < order.size(); i++) {
+        int rep = elems[bStart[order[i]]];
+        for (int a = 0; a < k; a++) {
+            int tb = blockOf[reachIdx[in.Next(reach[rep], a)]];
+            if (blockId[tb] == -1) {
+                blockId[tb] = order.size();
+                order.push_back(tb);
+            }
+        }
+    }
+
+    MinimizedDFA out;
+    out.dfa = DenseDFA(order.size(), k, 0);
+    for (size_t i = 0; i < order.size(); i++) {
+        int rep = elems[bStart[order[i]]];
+        out.dfa.accepting[i] = in.accepting[reach[rep]];
+        for (int a = 0; a < k; a++) {
+            out.dfa.table[i * k + a] = blockId[blockOf[reachIdx[in.Next(reach[rep], a)]]];
+        }
+    }
+
+    out.stateMap.assign(n, -1);
+    for (int s = 0; s < m; s++) {
+        out.stateMap[reach[s]] = blockId[blockOf[s]];
+    }
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,230 @@
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<vector>
+#include<map>
+#include "dense_dfa.h"
+
+using namespace std;
+
+// Turns a DFA into a standalone C++ matcher with one label per state and a
+// switch over the next byte, in the spirit of re2c / Ragel. The input is the
+// text form written by the --dump option of re_to_nfa, ends_with_automaton
+// and divisibility_fsm:
+//
+//   ./ends_with_automaton --dump ab bab bab.dfa
+//   ./dfa_codegen bab.dfa MatchBab > match_bab.cpp
+//
+// The DFA is minimized first. The generated file also carries the original
+// table and a randomized check against it, compiled in with
+// -DDFA_SELF_CHECK:
+//
+//   g++ -std=c++17 -O2 -DDFA_SELF_CHECK match_bab.cpp -o check && ./check
+
+// Case labels are byte values, the char goes in a comment when printable
+string ByteComment(int c) {
+    if (c >= 33 && c < 127 && c != '\\') {
+        return string("'") + (char) c + "'";
+    }
+    return "";
+}
+
+template<class T>
+void EmitArray(ostream& out, const string& type, const string& name, const vector<T>& values) {
+    out << "static const " << type << " " << name << "[" << values.size() << "] = {";
+    for (size_t i = 0; i < values.size(); i++) {
+        out << ((i % 16 == 0) ? "\n    " : " ") << values[i] << ",";
+    }
+    out << "\n};\n";
+}
+
+void EmitMatcher(ostream& out, const ByteDFA& b, const string& name) {
+    const DenseDFA& dfa = b.dfa;
+
+    // A DFA that is one absorbing state never looks at the input
+    if (dfa.nStates == 1) {
+        out << "bool " << name << "(const char*, size_t) {\n";
+        out << "    return " << (dfa.accepting[0] ? "true" : "false") << ";\n";
+        out << "}\n";
+        return;
+    }
+
+    out << "bool " << name << "(const char* data, size_t len) {\n";
+    out << "    const unsigned char* p = (const unsigned char*) data;\n";
+    out << "    const unsigned char* end = p + len;\n";
+    out << "    goto s" << dfa.start << ";\n";
+
+    for (int s = 0; s < dfa.nStates; s++) {
+        const char* result = dfa.accepting[s] ? "true" : "false";
+
+        // Target of every byte, and how often each target occurs
+        int target[256];
+        map<int, int> count;
+        for (int c = 0; c < 256; c++) {
+            target[c] = dfa.Next(s, b.byteClass[c]);
+            count[target[c]]++;
+        }
+
+        out << "\n";
+        out << "s" << s << ":\n";
+
+        // Absorbing state: the answer is known without reading further
+        if (count.size() == 1 && count.begin()->first == s) {
+            out << "    return " << result << ";\n";
+            continue;
+        }
+
+        out << "    if (p == end) return " << result << ";\n";
+        out << "    switch (*p++) {\n";
+
+        int common = count.begin()->first;
+        for (auto& t : count) {
+            if (t.second > count[common]) common = t.first;
+        }
+
+        for (auto& t : count) {
+            if (t.first == common) continue;
+            int onLine = 0;
+            string comment;
+            for (int c = 0; c < 256; c++) {
+                if (target[c] != t.first) continue;
+                if (onLine == 0) out << "        ";
+                out << "case " << c << ": ";
+                string cc = ByteComment(c);
+                if (!cc.empty()) comment += (comment.empty() ? "" : " ") + cc;
+                if (++onLine == 8) {
+                    out << (comment.empty() ? "" : "// " + comment) << "\n";
+                    onLine = 0;
+                    comment.clear();
+                }
+            }
+            if (onLine > 0) {
+                out << (comment.empty() ? "" : "// " + comment) << "\n";
+            }
+            out << "            goto s" << t.first << ";\n";
+        }
+        out << "        default:\n";
+        out << "            goto s" << common << ";\n";
+        out << "    }\n";
+    }
+    out << "}\n";
+}
+
+// Reference table run and randomized agreement check, behind DFA_SELF_CHECK
+void EmitSelfCheck(ostream& out, const ByteDFA& b, const string& name) {
+    const DenseDFA& dfa = b.dfa;
+
+    vector<int> classes(b.byteClass.begin(), b.byteClass.end());
+    vector<int> accepting(dfa.accepting.begin(), dfa.accepting.end());
+
+    // One byte per class, so the random inputs reach every transition
+    vector<int> representative;
+    vector<bool> seen(dfa.nSymbols, false);
+    for (int c = 0; c < 256; c++) {
+        if (!seen[b.byteClass[c]]) {
+            seen[b.byteClass[c]] = true;
+            representative.push_back(c);
+        }
+    }
+
+    // For the timing run: bytes that never lead into a dead state, so
+    // neither side can stop early. All classes if every one of them can.
+    vector<bool> dead(dfa.nStates);
+    for (int st = 0; st < dfa.nStates; st++) {
+        dead[st] = !dfa.accepting[st];
+        for (int a = 0; a < dfa.nSymbols; a++) {
+            if (dfa.Next(st, a) != st) dead[st] = false;
+        }
+    }
+    vector<int> live;
+    for (int c : representative) {
+        bool ok = true;
+        for (int st = 0; st < dfa.nStates; st++) {
+            if (!dead[st] && dead[dfa.Next(st, b.byteClass[c])]) ok = false;
+        }
+        if (ok) live.push_back(c);
+    }
+    if (live.empty()) live = representative;
+
+    out << "\n#ifdef DFA_SELF_CHECK\n";
+    out << "#include <cstdio>\n";
+    out << "#include <chrono>\n";
+    out << "#include <random>\n";
+    out << "#include <string>\n\n";
+    out << "// Table the matcher was generated from\n";
+    EmitArray(out, "int", name + "Table", dfa.table);
+    EmitArray(out, "int", name + "Class", classes);
+    EmitArray(out, "int", name + "Accepting", accepting);
+    EmitArray(out, "int", name + "Representative", representative);
+    EmitArray(out, "int", name + "Live", live);
+    out << "\n";
+    out << "static bool " << name << "RunTable(const char* data, size_t len) {\n";
+    out << "    int state = " << dfa.start << ";\n";
+    out << "    for (size_t i = 0; i < len; i++) {\n";
+    out << "        state = " << name << "Table[state * " << dfa.nSymbols << " + "
+        << name << "Class[(unsigned char) data[i]]];\n";
+    out << "    }\n";
+    out << "    return " << name << "Accepting[state];\n";
+    out << "}\n\n";
+    out << "int main() {\n";
+    out << "    std::mt19937 rng(1);\n";
+    out << "    const int inputs = 200000;\n";
+    out << "    int mismatches = 0;\n";
+    out << "    for (int i = 0; i < inputs; i++) {\n";
+    out << "        std::string s;\n";
+    out << "        int len = rng() % 65;\n";
+    out << "        for (int j = 0; j < len; j++) {\n";
+    out << "            // Mostly one byte per class, sometimes any byte\n";
+    out << "            if (rng() % 16 == 0) s += (char) (rng() % 256);\n";
+    out << "            else s += (char) " << name << "Representative[rng() % " << representative.size() << "];\n";
+    out << "        }\n";
+    out << "        if (" << name << "(s.data(), s.size()) != " << name << "RunTable(s.data(), s.size())) {\n";
+    out << "            mismatches++;\n";
+    out << "        }\n";
+    out << "    }\n";
+    out << "    printf(\"" << name << " : %d inputs, %d mismatches\\n\", inputs, mismatches);\n\n";
+    out << "    // Generated code against the table on one long input\n";
+    out << "    std::string big;\n";
+    out << "    for (int j = 0; j < (1 << 24); j++) {\n";
+    out << "        big += (char) " << name << "Live[rng() % " << live.size() << "];\n";
+    out << "    }\n";
+    out << "    auto t0 = std::chrono::steady_clock::now();\n";
+    out << "    bool a = " << name << "(big.data(), big.size());\n";
+    out << "    auto t1 = std::chrono::steady_clock::now();\n";
+    out << "    bool b = " << name << "RunTable(big.data(), big.size());\n";
+    out << "    auto t2 = std::chrono::steady_clock::now();\n";
+    out << "    printf(\"16M bytes : generated %.2f ms, table %.2f ms%s\\n\",\n";
+    out << "           std::chrono::duration<double, std::milli>(t1 - t0).count(),\n";
+    out << "           std::chrono::duration<double, std::milli>(t2 - t1).count(),\n";
+    out << "           (a == b) ? \"\" : \" (RESULTS DIFFER)\");\n";
+    out << "    return mismatches != 0 || a != b;\n";
+    out << "}\n";
+    out << "#endif\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <dfa file> [function name]" << endl;
+        return 1;
+    }
+
+    ifstream in(argv[1]);
+    ByteDFA b;
+    if (!in || !ReadByteDFA(in, b)) {
+        cerr << "Cannot read a DFA from " << argv[1] << endl;
+        return 1;
+    }
+    string name = (argc > 2) ? argv[2] : "Match";
+
+    // Drop classes no byte uses, then minimize over the remaining ones
+    ByteDFA minimal = MergeByteClasses(b);
+    minimal.dfa = MinimizeDFA(minimal.dfa).dfa;
+
+    cout << "// Generated by dfa_codegen from " << argv[1] << " : " << b.dfa.nStates
+         << " states, " << minimal.dfa.nStates << " after minimization. Do not edit.\n";
+    cout << "#include <cstddef>\n\n";
+    EmitMatcher(cout, minimal, name);
+    EmitSelfCheck(cout, b, name);
+
+    return 0;
+}
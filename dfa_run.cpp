@@ -0,0 +1,55 @@
+#include<iostream>
+#include<string>
+#include<chrono>
+#include<stdexcept>
+#include "dense_dfa.h"
+#include "mapped_image.h"
+
+using namespace std;
+
+// Runs inputs through a DFA image written by the --image option of
+// re_to_nfa, ends_with_automaton and divisibility_fsm. The image is mapped
+// and used in place, nothing is rebuilt:
+//
+//   ./divisibility_fsm --image 10 999983 div.img
+//   ./dfa_run div.img 1999966 1999967
+//
+// Without inputs on the command line, every line of stdin is one input.
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <image file> [input ...]" << endl;
+        return 1;
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.Open(argv[1])) {
+        cerr << "Cannot map " << argv[1] << endl;
+        return 1;
+    }
+
+    try {
+        ByteDFAView dfa(file.data(), file.size());
+        auto t1 = chrono::steady_clock::now();
+        cerr << "Loaded " << argv[1] << " : " << dfa.States() << " states, " << file.size()
+             << " bytes in " << chrono::duration<double, micro>(t1 - t0).count() << " us" << endl;
+
+        auto report = [&](const string& input) {
+            cout << "\"" << input << "\" -> " << (dfa.Accepts(input) ? "ACCEPTED" : "REJECTED") << "\n";
+        };
+        if (argc > 2) {
+            for (int i = 2; i < argc; i++) report(argv[i]);
+        }
+        else {
+            string line;
+            while (getline(cin, line)) report(line);
+        }
+    }
+    catch (const range_error& e) {
+        cerr << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
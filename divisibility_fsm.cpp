@@ -1,8 +1,23 @@
 #include <iostream>
+#include <fstream>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include <string_view>
+#include <span>
+#include <memory>
 #include <deque>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "dense_dfa.h"
+#include "parallel_dfa.h"
+#include "static_automaton.h"
+#include "tracer.h"
 #include<exception>
 #include<algorithm>
 
@@ -30,148 +45,753 @@ void PrintMap(unordered_map<char, int> map) {
   cout << "]" << endl;
 }
 
-const string NUMBER_LANG = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+// Default digit alphabet, bases above 62 need their own digits string
+const string NUMBER_LANG = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+// Transition tables above this many cells are not materialized, the
+// transitions are computed from the formula instead
+const size_t MAX_TABLE_CELLS = 1 << 26;
+
+// Budget for the stride table, sized to stay resident in L1
+const size_t STRIDE_TABLE_BYTES = 32 * 1024;
+const int MAX_STRIDE = 8;
+// Digits decoded per block before they are folded into the remainder
+const size_t DIGIT_BLOCK = 64;
+// Smallest chunk worth handing to a thread in runParallel
+const size_t MIN_PARALLEL_CHUNK = 1 << 16;
 
 class DivisibilityAutomaton {
   int _langBase;
+  string _digits;
   unordered_set<char> _lang;
-  vector<State> states;
   unordered_map<char, int> inCharRemSetIdx;
-  
 
-  vector<vector<int>> _transitions;
+  // State 0 is INIT, state r + 1 stands for remainder r (so state 1 is the
+  // SOL state) and the last state is TERM; they are implied, not stored
+  int _nStates;
+  int _nCols;
+
+  // One contiguous table _cellsN[state * _nCols + col], only the vector of
+  // the narrowest cell type that holds every state number is filled.
+  // _cellBytes is 0 when the table would exceed MAX_TABLE_CELLS.
+  int _cellBytes;
+  vector<uint8_t> _cells8;
+  vector<uint16_t> _cells16;
+  vector<uint32_t> _cells32;
+
+  int _curState;    // Current state of the stream fed so far
+  size_t _pos;      // Chars fed since the last reset
+
+  int _divisor;
+  bool _simdDigits;           // _digits is a prefix of NUMBER_LANG
+  int _digitValue[256];       // ASCII -> digit value, -1 outside the language
+  int _digitColumn[256];      // ASCII -> transition column, -1 outside the language
+
+  // Stride table consuming _stride digits per lookup:
+  // _strideTable[r * _strideBase + v] = (r * _strideBase + v) % divisor
+  // where v is the value of the next _stride digits. Left empty when even
+  // one digit per lookup does not fit the budget, the remainder is then
+  // folded arithmetically.
+  int _stride;
+  int _strideBase;            // _langBase ^ _stride
+  vector<int> _strideTable;
+
+  // toByteDFA of the table for runBatch and runParallelStates, built on
+  // first use. The table never changes after construction, so it is kept.
+  shared_ptr<const ByteDFA> _byteDFA;
+
+  void buildTable();
+  template<class Cell>
+  void fillTable(vector<Cell>& cells);
+  void buildStrideTable();
+  size_t decodeDigits(const char* data, size_t len, uint8_t* out) const;
+  size_t foldDigits(const char* data, size_t len, int& r) const;
+  void feedStride(const char* data, size_t len);
+  int powMod(size_t exponent) const;
+  const ByteDFA* batchDFA(size_t bytes);
 
   bool checkChar(char c) {
     auto it = _lang.find(c);
     return it != _lang.end();
   }
 
+  StateType stateType(int s) const {
+    if (s == 0) return INIT;
+    if (s == 1) return SOL;
+    if (s == _nStates - 1) return TERM;
+    return BRANCH;
+  }
+
+  int next(int state, int col) const {
+    size_t i = (size_t) state * _nCols + col;
+    switch (_cellBytes) {
+      case 1: return _cells8[i];
+      case 2: return _cells16[i];
+      case 4: return _cells32[i];
+    }
+    if (state == 0) return col + 1;
+    if (state == _nStates - 1) return state;
+    return ((long long) _langBase * (state - 1) + col) % _divisor + 1;
+  }
+
  public:
-  DivisibilityAutomaton(int inputLangBase, int divisor);
+  // Digits of the number are the first inputLangBase chars of 'digits'
+  DivisibilityAutomaton(int inputLangBase, int divisor, const string& digits = NUMBER_LANG);
 
   void printStates() {
-    for (State& s : this->states) {
-      DisplayState(s);
+    for (int i = 0; i < _nStates; i++) {
+      int data = (stateType(i) == TERM) ? INT32_MAX : max(i - 1, 0);
+      DisplayState(State(data, stateType(i)));
     }
     cout << endl;
   }
 
   void printTransitions() {
-    for (int i = 0; i < _transitions.size(); i++) {
+    for (int i = 0; i < _nStates; i++) {
       cout << i << " | ";
-      for (int x : _transitions[i]) {
-        cout << x << ",";
+      for (int j = 0; j < _nCols; j++) {
+        cout << next(i, j) << ",";
       }
       cout << endl;
     }
     cout << endl;
   }
 
+  // Bytes held by the tables, and a breakdown on stdout
+  size_t memoryUsage() const;
+  void printMemoryUsage() const;
+
   void printPatternCharIdx() { PrintMap(this->inCharRemSetIdx); }
 
-  bool run(string input);
+  // Transition table as a DenseDFA over the remainder columns. Like
+  // toByteDFA it throws range_error when the table is not materialized.
+  DenseDFA toDenseDFA();
+
+  // Complete byte-level table: the remainder columns plus one column for
+  // bytes outside the language (to the absorbing TERM state)
+  ByteDFA toByteDFA();
+
+  // Report how many states a Hopcroft-minimized table needs
+  void printMinimized();
+
+  // Runs and feeds report their steps to a tracer (see tracer.h), the
+  // overloads without one use NullTracer and do no tracing at all
+  //
+  // The untraced overloads take the stride path: digits are decoded a block
+  // at a time and folded into the remainder _stride digits per lookup. The
+  // traced ones step one digit at a time so every transition is reported.
+  template<class Tracer>
+  bool run(string_view input, Tracer& tracer);
+  bool run(string_view input) { reset(); feedStride(input.data(), input.size()); return finish(); }
+  bool run(const char* data, size_t len) { return run(string_view(data, len)); }
+
+  // Streaming interface: feed() may be called any number of times with
+  // consecutive chunks of one input, finish() reports whether the whole
+  // input is accepted and resets for the next one
+  void reset() { _curState = 0; _pos = 0; }
+  template<class Tracer>
+  void feed(const char* data, size_t len, Tracer& tracer);
+  void feed(const char* data, size_t len) { feedStride(data, len); }
+  bool finish();
+
+  // Splits the input into one chunk per thread, computes each chunk's
+  // remainder from 0 and combines them left to right with
+  // r = r_left * base^len_right + r_right (mod divisor). Inputs too short to
+  // be worth the threads run serially. Independent of the streaming state.
+  bool runParallel(string_view input, int threads);
+
+  // Same split run over per-chunk state maps (see parallel_dfa.h). The
+  // remainder states never merge when gcd(base, divisor) = 1, so this
+  // tracks every state and runParallel is the faster choice; it is kept
+  // for comparison with the generic technique. Falls back to run() when
+  // the table is not materialized or is large next to the input.
+  bool runParallelStates(string_view input, int threads);
+
+  // out[i] = run(inputs[i]) for a whole batch, inputs interleaved per thread
+  // (see parallel_dfa.h), independent of the streaming state. Batches small
+  // next to the table just loop over run().
+  void runBatch(span<const string_view> inputs, bool* out, int threads = 1);
+
+  // Digits per stride lookup, 0 when the remainder is folded arithmetically
+  int strideDigits() const { return _strideTable.empty() ? 0 : _stride; }
 };
 
 // Updated the Transition table to Include routes to self at solState for any input char
-DivisibilityAutomaton::DivisibilityAutomaton(int inputLangBase, int divisor) {
-  if (inputLangBase > 35) {
-    throw range_error("Please Enter Values 1 <= x <= 35");
+DivisibilityAutomaton::DivisibilityAutomaton(int inputLangBase, int divisor, const string& digits) {
+  if (inputLangBase < 1 || inputLangBase > 256 || inputLangBase > digits.size()) {
+    throw range_error("Base must be 1 <= x <= 256 and have a digit for every value");
+  }
+  if (divisor < 1 || divisor > INT32_MAX - 2) {
+    throw range_error("Divisor must be 1 <= x <= INT32_MAX - 2");
   }
   _langBase = inputLangBase;
-  _lang = unordered_set<char>(NUMBER_LANG.begin(), NUMBER_LANG.begin() + _langBase);
+  _digits = digits.substr(0, _langBase);
+  _divisor = divisor;
+  _curState = 0;
+  _pos = 0;
+  _lang = unordered_set<char>(_digits.begin(), _digits.end());
+  if (_lang.size() != _digits.size()) {
+    throw range_error("Digits must be distinct");
+  }
+  _simdDigits = (NUMBER_LANG.compare(0, _digits.size(), _digits) == 0);
 
-  // Create Initial State
-  states.push_back(State(0, INIT));
+  // INIT, one state per remainder, TERM for sys Faults
+  _nStates = divisor + 2;
 
-  // Add States Based on the Pattern
-  for (int i = 0; i < divisor; i++) {
-    states.push_back(State(i) );
+  // Create Inputs Set of Chars which will lead to the Same Divsible State
+  for (int i = 0; i < _langBase; i++) {
+    inCharRemSetIdx.insert(pair<char, int>(_digits[i], i % divisor) );
   }
 
-  // Remainder 0 must be Solution
-  states[1]._t = SOL;
+  // Flat lookups for the run loops, no hashing per char
+  fill(begin(_digitValue), end(_digitValue), -1);
+  fill(begin(_digitColumn), end(_digitColumn), -1);
+  for (int i = 0; i < _langBase; i++) {
+    _digitValue[(unsigned char) _digits[i]] = i;
+    _digitColumn[(unsigned char) _digits[i]] = i % divisor;
+  }
 
-  // Add terminate State for sys Faults
-  states.push_back(State(INT32_MAX, TERM) );
+  _nCols = min(_langBase, divisor);
+  buildTable();
+  buildStrideTable();
+}
 
-  // Create Inputs Set of Chars which will lead to the Same Divsible State
-  for (int i = 0; i < _lang.size(); i++) {
-    inCharRemSetIdx.insert(pair<char, int>(NUMBER_LANG[i], i % divisor) );
-  }
+// Pick the narrowest cell type holding every state number
+void DivisibilityAutomaton::buildTable() {
+  size_t cells = (size_t) _nStates * _nCols;
+  int maxState = _nStates - 1;
 
-  // Allocate Transition table
-  int nCols = min((int) _lang.size(), divisor);
-  _transitions =
-      vector<vector<int>>(states.size(), vector<int>( nCols) );
-  
+  if (cells > MAX_TABLE_CELLS) {
+    _cellBytes = 0;
+  }
+  else if (maxState <= UINT8_MAX) {
+    _cellBytes = 1;
+    fillTable(_cells8);
+  }
+  else if (maxState <= UINT16_MAX) {
+    _cellBytes = 2;
+    fillTable(_cells16);
+  }
+  else {
+    _cellBytes = 4;
+    fillTable(_cells32);
+  }
+}
 
+template<class Cell>
+void DivisibilityAutomaton::fillTable(vector<Cell>& cells) {
+  cells.resize((size_t) _nStates * _nCols);
 
   // Setup Main Transition Links
   // For Initial State Input Set maps to Direct Divisor
-  for (int c = 0; c < nCols; c++) {
-    _transitions[0][c] = c + 1;
+  for (int c = 0; c < _nCols; c++) {
+    cells[c] = c + 1;
   }
   // For Remaining Use Formula (BASE * Remainder + InputDigit) mod Divisor
-  for (int i = 1; i <= divisor; ++i) {
-    for (int j = 0; j < nCols; j++) {
-      _transitions[i][j] = ( (_langBase*(i-1) + j) % divisor) + 1;
-    }    
+  for (int i = 1; i <= _divisor; ++i) {
+    for (int j = 0; j < _nCols; j++) {
+      cells[(size_t) i * _nCols + j] = ((long long) _langBase * (i - 1) + j) % _divisor + 1;
+    }
+  }
+  // TERM absorbs everything
+  int trap = _nStates - 1;
+  for (int j = 0; j < _nCols; j++) {
+    cells[(size_t) trap * _nCols + j] = trap;
+  }
+}
+
+// Pick the widest stride whose table still fits STRIDE_TABLE_BYTES, at
+// least one digit per lookup however large the divisor
+void DivisibilityAutomaton::buildStrideTable() {
+  _stride = 1;
+  _strideBase = _langBase;
+  while (_stride < MAX_STRIDE &&
+         (long long) _divisor * _strideBase * _langBase * sizeof(int) <= STRIDE_TABLE_BYTES) {
+    _stride++;
+    _strideBase *= _langBase;
+  }
+
+  if ((long long) _divisor * _strideBase * sizeof(int) > STRIDE_TABLE_BYTES) {
+    _strideTable.clear();
+    return;
+  }
+
+  _strideTable.resize((size_t) _divisor * _strideBase);
+  for (size_t i = 0; i < _strideTable.size(); i++) {
+    _strideTable[i] = i % _divisor;
+  }
+}
+
+// Writes the digit values of the leading valid chars of data to out and
+// returns how many there are; a return below len means data[ret] is outside
+// the language
+size_t DivisibilityAutomaton::decodeDigits(const char* data, size_t len, uint8_t* out) const {
+  size_t i = 0;
+#ifdef __SSE2__
+  // 16 chars at a time: '0'-'9' -> 0-9, 'A'-'Z' -> 10-35, 'a'-'z' -> 36-61,
+  // anything else -> 0 and invalid, then everything at or above the base is
+  // invalid as well. The subtractions wrap, but only the intended range
+  // lands in each window. Custom digit alphabets take the lookup below.
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i upperBase = _mm_set1_epi8('A' - 10);
+  const __m128i lowerBase = _mm_set1_epi8('a' - 36);
+  const __m128i minusOne = _mm_set1_epi8(-1);
+  const __m128i nine = _mm_set1_epi8(9);
+  const __m128i ten = _mm_set1_epi8(10);
+  const __m128i upperEnd = _mm_set1_epi8(36);
+  const __m128i lowerStart = _mm_set1_epi8(35);
+  const __m128i lowerEnd = _mm_set1_epi8(62);
+  const __m128i base = _mm_set1_epi8(_langBase);
+  size_t simdEnd = _simdDigits ? len : 0;
+  for (; i + 16 <= simdEnd; i += 16) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (data + i));
+    __m128i dig = _mm_sub_epi8(c, zero);
+    __m128i up = _mm_sub_epi8(c, upperBase);
+    __m128i low = _mm_sub_epi8(c, lowerBase);
+    __m128i isDig = _mm_and_si128(_mm_cmpgt_epi8(dig, minusOne), _mm_cmplt_epi8(dig, ten));
+    __m128i isUp = _mm_and_si128(_mm_cmpgt_epi8(up, nine), _mm_cmplt_epi8(up, upperEnd));
+    __m128i isLow = _mm_and_si128(_mm_cmpgt_epi8(low, lowerStart), _mm_cmplt_epi8(low, lowerEnd));
+    __m128i value = _mm_or_si128(_mm_or_si128(_mm_and_si128(isDig, dig), _mm_and_si128(isUp, up)),
+                                 _mm_and_si128(isLow, low));
+    __m128i inAlphabet = _mm_or_si128(_mm_or_si128(isDig, isUp), isLow);
+    __m128i valid = _mm_and_si128(inAlphabet, _mm_cmplt_epi8(value, base));
+    _mm_storeu_si128((__m128i*) (out + i), value);
+
+    int bad = ~_mm_movemask_epi8(valid) & 0xFFFF;
+    if (bad) {
+      return i + __builtin_ctz(bad);
+    }
+  }
+#endif
+  for (; i < len; i++) {
+    int d = _digitValue[(unsigned char) data[i]];
+    if (d < 0) break;
+    out[i] = d;
+  }
+  return i;
+}
+
+// Folds the leading valid digits of data into the remainder r and returns
+// how many there were, like decodeDigits
+size_t DivisibilityAutomaton::foldDigits(const char* data, size_t len, int& r) const {
+  uint8_t digits[DIGIT_BLOCK];
+  const int* table = _strideTable.data();
+  int stride = _strideTable.empty() ? DIGIT_BLOCK + 1 : _stride;
+  int base = _langBase;
+  int strideBase = _strideBase;
+
+  // Locals, so the stores to r and digits cannot force member reloads
+  int rem = r;
+  size_t i = 0;
+  while (i < len) {
+    size_t n = min(len - i, DIGIT_BLOCK);
+    size_t valid = decodeDigits(data + i, n, digits);
+
+    // The k digit values are independent of rem, only the table lookup is
+    // on the dependency chain
+    size_t j = 0;
+    for (; j + stride <= valid; j += stride) {
+      int v = 0;
+      for (int k = 0; k < stride; k++) {
+        v = v * base + digits[j + k];
+      }
+      rem = table[rem * strideBase + v];
+    }
+    for (; j < valid; j++) {
+      rem = ((long long) rem * base + digits[j]) % _divisor;
+    }
+
+    i += valid;
+    if (valid < n) break;
+  }
+
+  r = rem;
+  return i;
+}
+
+void DivisibilityAutomaton::feedStride(const char* data, size_t len) {
+  // The TERM state is the last one and absorbs the rest of the stream
+  int trap = _nStates - 1;
+  if (_curState == trap || len == 0) return;
 
+  // Work on the remainder directly, state = remainder + 1
+  int r = (_curState == 0) ? 0 : _curState - 1;
+  size_t valid = foldDigits(data, len, r);
+  _pos += valid;
+  _curState = (valid < len) ? trap : r + 1;
+}
+
+// base^exponent mod divisor by repeated squaring
+int DivisibilityAutomaton::powMod(size_t exponent) const {
+  long long result = 1 % _divisor;
+  long long sq = _langBase % _divisor;
+  while (exponent) {
+    if (exponent & 1) result = result * sq % _divisor;
+    sq = sq * sq % _divisor;
+    exponent >>= 1;
+  }
+  return result;
+}
+
+bool DivisibilityAutomaton::runParallel(string_view input, int threads) {
+  size_t len = input.size();
+  if (len == 0) return false;
+  if (threads < 1) threads = 1;
+  if ((size_t) threads > len / MIN_PARALLEL_CHUNK) {
+    threads = max<size_t>(1, len / MIN_PARALLEL_CHUNK);
   }
 
+  // Equal chunks, the last one takes the remainder
+  size_t chunk = len / threads;
+  vector<int> rem(threads, 0);
+  vector<char> ok(threads, 0);
+  auto work = [&](int t) {
+    size_t begin = t * chunk;
+    size_t n = (t == threads - 1) ? len - begin : chunk;
+    ok[t] = (foldDigits(input.data() + begin, n, rem[t]) == n);
+  };
+
+  vector<thread> pool;
+  for (int t = 1; t < threads; t++) {
+    pool.emplace_back(work, t);
+  }
+  work(0);
+  for (thread& th : pool) th.join();
+
+  // Every chunk but the last has the same length, so one power serves them
+  long long shift = powMod(chunk);
+  long long r = 0;
+  for (int t = 0; t < threads; t++) {
+    if (!ok[t]) return false;
+    long long s = (t == threads - 1) ? powMod(len - t * chunk) : shift;
+    r = (r * s + rem[t]) % _divisor;
+  }
+  return r == 0;
 }
 
-bool DivisibilityAutomaton::run(string input) {
-  // Always Start at Initial State
-  int stateNo = 0;
-  int charIdx;
+template<class Tracer>
+bool DivisibilityAutomaton::run(string_view input, Tracer& tracer) {
+  reset();
+  feed(input.data(), input.size(), tracer);
+
+  if constexpr (Tracer::enabled) {
+    TraceKind kind = (stateType(_curState) == SOL) ? TRACE_ACCEPT : TRACE_REJECT;
+    tracer.OnEvent({kind, _pos, '\0', _curState, _curState, -1});
+  }
+
+  return finish();
+}
+
+template<class Tracer>
+void DivisibilityAutomaton::feed(const char* data, size_t len, Tracer& tracer) {
+  // The TERM state is the last one and absorbs the rest of the stream
+  int trap = _nStates - 1;
+
+  for (size_t i = 0; i < len && _curState != trap; i++, _pos++) {
+    char c = data[i];
 
-  for (char c : input) {
     // Check if Valid Character else send to trap State
-    if (_lang.find(c) == _lang.end() ) {
-      cout<<"Char '"<< c <<"'  not in Automatons Language..."<<endl;
-      cout<<"Recahed TRAP state Terminating...."<<endl;
-      return false;
+    int col = _digitColumn[(unsigned char) c];
+    if (col < 0) {
+      if constexpr (Tracer::enabled) {
+        tracer.OnEvent({TRACE_TRAP, _pos, c, _curState, trap, -1});
+      }
+      _curState = trap;
+      break;
+    }
+
+    // Update State
+    int next = this->next(_curState, col);
+    if constexpr (Tracer::enabled) {
+      tracer.OnEvent({TRACE_STEP, _pos, c, _curState, next, -1});
+    }
+    _curState = next;
+  }
+}
+
+bool DivisibilityAutomaton::finish() {
+  // If reached Solution State the input is accepted
+  bool ans = (stateType(_curState) == SOL);
+  reset();
+  return ans;
+}
+
+DenseDFA DivisibilityAutomaton::toDenseDFA() {
+  if (_cellBytes == 0) {
+    throw range_error("Transition table is not materialized for this divisor");
+  }
+  DenseDFA dfa(_nStates, _nCols, 0);
+
+  for (int i = 0; i < _nStates; i++) {
+    dfa.accepting[i] = (stateType(i) == SOL);
+    for (int j = 0; j < _nCols; j++) {
+      dfa.table[i * _nCols + j] = next(i, j);
+    }
+  }
+
+  return dfa;
+}
+
+ByteDFA DivisibilityAutomaton::toByteDFA() {
+  if (_cellBytes == 0) {
+    throw range_error("Transition table is not materialized for this divisor");
+  }
+  int trapCol = _nCols;
+  int trap = _nStates - 1;
+
+  ByteDFA b;
+  b.dfa = DenseDFA(_nStates, _nCols + 1, 0);
+  for (int i = 0; i < _nStates; i++) {
+    b.dfa.accepting[i] = (stateType(i) == SOL);
+    for (int j = 0; j < _nCols; j++) {
+      b.dfa.table[i * b.dfa.nSymbols + j] = next(i, j);
     }
+    b.dfa.table[i * b.dfa.nSymbols + trapCol] = trap;
+  }
+
+  for (int c = 0; c < 256; c++) {
+    b.byteClass[c] = (_digitColumn[c] < 0) ? trapCol : _digitColumn[c];
+  }
+
+  return b;
+}
+
+size_t DivisibilityAutomaton::memoryUsage() const {
+  return _cells8.capacity() * sizeof(uint8_t) + _cells16.capacity() * sizeof(uint16_t)
+       + _cells32.capacity() * sizeof(uint32_t) + _strideTable.capacity() * sizeof(int)
+       + sizeof(_digitValue) + sizeof(_digitColumn);
+}
+
+void DivisibilityAutomaton::printMemoryUsage() const {
+  cout << "Base " << _langBase << " mod " << _divisor << " : " << _nStates << " states x "
+       << _nCols << " columns" << endl;
+  if (_cellBytes == 0) {
+    cout << "   transitions : computed, table above " << MAX_TABLE_CELLS << " cells" << endl;
+  }
+  else {
+    cout << "   transitions : " << (size_t) _nStates * _nCols * _cellBytes << " bytes ("
+         << 8 * _cellBytes << "-bit cells)" << endl;
+  }
+  if (_strideTable.empty()) {
+    cout << "   stride      : none, remainder folded arithmetically" << endl;
+  }
+  else {
+    cout << "   stride      : " << _strideTable.size() * sizeof(int) << " bytes ("
+         << _stride << " digits per lookup)" << endl;
+  }
+  cout << "   char maps   : " << sizeof(_digitValue) + sizeof(_digitColumn) << " bytes" << endl;
+  cout << "   total       : " << memoryUsage() << " bytes" << endl << endl;
+}
 
-    // Check if Character is in the Pattern
-    auto it = inCharRemSetIdx.find(c);
-    if (it != inCharRemSetIdx.end() ) {
-      charIdx = it->second;
-      // Update State
-      stateNo = _transitions[stateNo][charIdx];
+// Cached ByteDFA for a run over 'bytes' of input, or nullptr when there is
+// no table or building one would take longer than just running the input
+const ByteDFA* DivisibilityAutomaton::batchDFA(size_t bytes) {
+  if (_cellBytes == 0) return nullptr;
+  if (!_byteDFA) {
+    if (bytes < (size_t) _nStates * (_nCols + 1)) return nullptr;
+    _byteDFA = make_shared<const ByteDFA>(toByteDFA());
+  }
+  return _byteDFA.get();
+}
+
+bool DivisibilityAutomaton::runParallelStates(string_view input, int threads) {
+  const ByteDFA* b = batchDFA(input.size());
+  if (!b) return run(input);
+  int end = RunParallel(*b, input.data(), input.size(), threads);
+  return b->dfa.accepting[end];
+}
+
+void DivisibilityAutomaton::runBatch(span<const string_view> inputs, bool* out, int threads) {
+  size_t bytes = 0;
+  for (string_view in : inputs) bytes += in.size();
+
+  // Without a table worth building there is nothing to interleave
+  const ByteDFA* b = batchDFA(bytes);
+  if (!b) {
+    for (size_t i = 0; i < inputs.size(); i++) out[i] = run(inputs[i]);
+    return;
+  }
+  RunBatch(*b, inputs, out, threads);
+}
+
+void DivisibilityAutomaton::printMinimized() {
+  MinimizedDFA minimal = MinimizeDFA(toDenseDFA());
+
+  cout << "States : " << _nStates << " -> Minimal : " << minimal.dfa.nStates << endl;
+  for (int i = 0; i < minimal.stateMap.size(); i++) {
+    cout << "   " << i << " -> ";
+    if (minimal.stateMap[i] == -1) {
+      cout << "unreachable" << endl;
+    }
+    else {
+      cout << minimal.stateMap[i] << endl;
     }
-    
   }
+  cout << endl;
+}
 
-  cout<<"Final State : "<<endl;
-  DisplayState(states[stateNo]);
-  
-  // If reached Solution State Exit
-  if (states[stateNo]._t == SOL) {
-    return true;
+// Digit-at-a-time run against the stride path on long numeric strings
+void RunBenchmarks() {
+  mt19937 rng(11);
+  cout << "Stride benchmark : 10M digit inputs" << endl;
+  cout << "===================================" << endl;
+
+  for (auto cfg : vector<pair<int, int>>{{10, 3}, {10, 7}, {10, 97}, {16, 255}, {2, 5}, {10, 100003}}) {
+    DivisibilityAutomaton a(cfg.first, cfg.second);
+    string input;
+    input.reserve(10000000);
+    input += NUMBER_LANG[1 + rng() % (cfg.first - 1)];
+    while (input.size() < 10000000) input += NUMBER_LANG[rng() % cfg.first];
+
+    NullTracer quiet;
+    auto t0 = chrono::steady_clock::now();
+    bool perDigit = a.run(input, quiet);
+    auto t1 = chrono::steady_clock::now();
+    bool stride = a.run(input);
+    auto t2 = chrono::steady_clock::now();
+
+    double ms1 = chrono::duration<double, milli>(t1 - t0).count();
+    double ms2 = chrono::duration<double, milli>(t2 - t1).count();
+    cout << "Base " << cfg.first << " mod " << cfg.second << " : per digit " << ms1
+         << " ms | stride " << a.strideDigits() << " " << ms2 << " ms ("
+         << ms1 / ms2 << "x)" << (perDigit == stride ? "" : " RESULTS DIFFER") << endl;
   }
 
-  return false;
+  cout << endl << "Parallel benchmark : 64M digit input, base 10 mod 7" << endl;
+  cout << "===================================================" << endl;
+
+  DivisibilityAutomaton a(10, 7);
+  string input;
+  input.reserve(1 << 26);
+  input += '1';
+  while (input.size() < (1 << 26)) input += NUMBER_LANG[rng() % 10];
+
+  auto t0 = chrono::steady_clock::now();
+  bool serial = a.run(input);
+  auto t1 = chrono::steady_clock::now();
+  double serialMs = chrono::duration<double, milli>(t1 - t0).count();
+  cout << "serial    : " << serialMs << " ms" << endl;
+
+  int hw = max(1u, thread::hardware_concurrency());
+  for (int threads = 1; threads <= 2 * hw; threads *= 2) {
+    auto t2 = chrono::steady_clock::now();
+    bool parallel = a.runParallel(input, threads);
+    auto t3 = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(t3 - t2).count();
+    cout << threads << " threads : " << ms << " ms (" << serialMs / ms << "x)"
+         << (parallel == serial ? "" : " RESULTS DIFFER") << endl;
+  }
+
+  // The generic state-map run has to carry all divisor + 2 states
+  auto t4 = chrono::steady_clock::now();
+  bool mapped = a.runParallelStates(input, 2 * hw);
+  auto t5 = chrono::steady_clock::now();
+  cout << "state maps, " << 2 * hw << " threads : "
+       << chrono::duration<double, milli>(t5 - t4).count() << " ms"
+       << (mapped == serial ? "" : " RESULTS DIFFER") << endl;
+}
+
+// Strings per second for 1M short inputs: one run() per string against
+// the interleaved batch, single and multi-threaded
+void RunBatchBenchmark() {
+  mt19937 rng(23);
+  DivisibilityAutomaton a(10, 7);
+  vector<string> records;
+  for (int i = 0; i < 1000000; i++) {
+    int len = 8 + rng() % 57;
+    string record;
+    for (int j = 0; j < len; j++) record += NUMBER_LANG[rng() % 10];
+    records.push_back(record);
+  }
+  vector<string_view> views(records.begin(), records.end());
+  vector<bool> expected(views.size());
+  unique_ptr<bool[]> out(new bool[views.size()]);
+
+  cout << endl << "Batch benchmark : 1M strings of 8-64 chars" << endl;
+  cout << "==========================================" << endl;
+
+  auto t0 = chrono::steady_clock::now();
+  for (size_t i = 0; i < views.size(); i++) expected[i] = a.run(views[i]);
+  auto t1 = chrono::steady_clock::now();
+  double sec = chrono::duration<double>(t1 - t0).count();
+  cout << "run() each  : " << views.size() / sec / 1e6 << " M strings/s" << endl;
+
+  int hw = max(1u, thread::hardware_concurrency());
+  for (int threads : {1, hw}) {
+    auto t2 = chrono::steady_clock::now();
+    a.runBatch(views, out.get(), threads);
+    auto t3 = chrono::steady_clock::now();
+    double s = chrono::duration<double>(t3 - t2).count();
+    bool same = equal(expected.begin(), expected.end(), out.get());
+    cout << "runBatch " << threads << "t : " << views.size() / s / 1e6 << " M strings/s"
+         << (same ? "" : " RESULTS DIFFER") << endl;
+  }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+  if (argc > 1 && string(argv[1]) == "--bench") {
+    RunBenchmarks();
+    RunBatchBenchmark();
+    return 0;
+  }
+
+  // --dump <base> <divisor> <file> : run table in the text form read by dfa_codegen
+  if (argc > 4 && string(argv[1]) == "--dump") {
+    ofstream out(argv[4]);
+    WriteByteDFA(out, DivisibilityAutomaton(stoi(argv[2]), stoi(argv[3])).toByteDFA());
+    return 0;
+  }
+
+  // --image <base> <divisor> <file> : binary run table for dfa_run
+  if (argc > 4 && string(argv[1]) == "--image") {
+    ofstream out(argv[4], ios::binary);
+    return WriteByteDFAImage(out, DivisibilityAutomaton(stoi(argv[2]), stoi(argv[3])).toByteDFA()) ? 0 : 1;
+  }
+
   DivisibilityAutomaton a(16, 3);
   vector<string> testStrings = {
     "1F",
-    "4FB"
+    "4FB",
+    "1Z"
   };
 
   // a.printStates();
   // a.printPatternCharIdx();
   // a.printTransitions();
+  a.printMinimized();
 
+  CoutTracer tracer;
   for (string s : testStrings) {
     cout<<"String : "<< s <<endl;
-    bool ans = a.run(s);
+    bool ans = a.run(s, tracer);
     cout<<"Ans : "<< ans <<endl<<endl;
   }
-  
+
+  // Same input delivered one digit at a time
+  string stream = testStrings[1];
+  for (char c : stream) {
+    a.feed(&c, 1);
+  }
+  cout<<"Streamed : "<< stream <<endl<<"Ans : "<< a.finish() <<endl<<endl;
+
+  // Same automaton with its table built at compile time
+  using StaticHex3 = StaticDivisibility<16, 3>;
+  static_assert(StaticHex3::Run("4FB") && !StaticHex3::Run("1F") && !StaticHex3::Run("1Z"));
+  for (string s : testStrings) {
+    cout<<"Static : "<< s <<endl<<"Ans : "<< StaticHex3::Run(s) <<endl<<endl;
+  }
+
+  // Table sizes from a tiny divisor up to one too large to tabulate
+  a.printMemoryUsage();
+  DivisibilityAutomaton(10, 1000000).printMemoryUsage();
+  DivisibilityAutomaton(10, 1000000007).printMemoryUsage();
+
+  // Bases past the default alphabet bring their own digits
+  const string BASE64_DIGITS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  DivisibilityAutomaton b64(64, 7, BASE64_DIGITS);
+  cout<<"Base 64 \"BA\" mod 7 : "<< b64.run("BA") <<endl;   // 64 = 7 * 9 + 1
+  cout<<"Base 64 \"BH\" mod 7 : "<< b64.run("BH") <<endl;   // 71 = 7 * 10 + 1
+  cout<<"Base 64 \"BG\" mod 7 : "<< b64.run("BG") <<endl;   // 70 = 7 * 10
 
   return 0;
 }
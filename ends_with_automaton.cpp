@@ -1,202 +1,817 @@
-#include <iostream>
-#include <unordered_map>
-#include <unordered_set>
-#include <vector>
-#include <deque>
-
-using namespace std;
-
-enum StateType { INIT, BRANCH, SOL, TERM };
-
-typedef struct State {
-  string _data;
-  StateType _t;
-
-  State(string data, StateType type = BRANCH) : _data(data), _t(type) {}
-} State;
-
-void DisplayState(const State s) {
-  cout << "Data : " << s._data << endl;
-  cout << "Type : " << s._t << endl;
-}
-
-void PrintMap(unordered_map<char, int> map) {
-  cout << "[";
-  for (auto p : map) {
-    cout << "{" << p.first << " : " << p.second << "}, ";
-  }
-  cout << "]" << endl;
-}
-
-class Automaton {
-  unordered_set<char> _lang;
-  vector<State> states;
-  string patternChars;
-  unordered_map<char, int> patternCharsIdx;
-
-  vector<vector<int>> _transitions;
-
-  bool checkChar(char c) {
-    auto it = _lang.find(c);
-    return it != _lang.end();
-  }
-
- public:
-  Automaton(string language, string endPattern);
-
-  void printStates() {
-    for (State& s : this->states) {
-      DisplayState(s);
-    }
-    cout << endl;
-  }
-
-  void printTransitions() {
-    for (int i = 0; i < _transitions.size(); i++) {
-      cout << i << " | ";
-      for (int x : _transitions[i]) {
-        cout << x << ",";
-      }
-      cout << endl;
-    }
-    cout << endl;
-  }
-
-  void printPatternCharIdx() { PrintMap(this->patternCharsIdx); }
-
-  bool run(string input);
-};
-
-Automaton::Automaton(string language, string endPattern) {
-  _lang = unordered_set<char>(language.begin(), language.end());
-
-  // Create Initial State
-  states.push_back(State("", INIT));
-
-  // Add States Based on the Pattern
-  string pat = "";
-  for (int i = 0; i < endPattern.size(); i++) {
-    pat.push_back(endPattern[i]);
-    states.push_back(pat);
-  }
-
-  states.back()._t = SOL;
-
-  // Add terminate State for sys Faults
-  states.push_back(State("", TERM) );
-
-  // get the Unique Characters Required in the end Pattern
-  for (char c : endPattern) {
-    auto it = patternCharsIdx.find(c);
-    if (it == patternCharsIdx.end()) {
-      patternCharsIdx.insert({c, patternCharsIdx.size()});
-      patternChars.push_back(c);
-    }
-  }
-  patternCharsIdx = patternCharsIdx;
-
-  // Allocate Transition table
-  _transitions =
-      vector<vector<int>>(states.size(), vector<int>(patternCharsIdx.size()));
-  
-
-
-  // Setup Main Transition Links
-  for (int i = 0; i < endPattern.size(); ++i) {
-    // Get the Uniq Chars Index for the Input character in the Finding Pattern
-    int idx = patternCharsIdx.find(endPattern[i])->second;
-    
-    _transitions[i][idx] = i + 1;
-
-    cout << endl;
-  }
-
-  // Other Transition Links
-  // Skipping First Row Since all other chars apart from first Pattern input
-  // char will result in Q0 only
-  string inStr = "";
-  bool matchFound = false;
-  for (int i = 1; i <= endPattern.length(); i++) {
-    // Put for All Unallocated States
-    for (int col = 0; col < patternChars.size(); col++) {
-      
-      if (_transitions[i][col] == 0) {
-        inStr = states[i]._data + patternChars[col];
-      
-        // Check if Substrings [1:n], ... exist as states
-        // Donot consider Final Terminating Character
-        deque<char> q(inStr.begin(), inStr.end() );
-      
-        // Removing the first char since we know curr inStr doesnt exist as a State
-        q.pop_front();
-        matchFound = false;
-
-        while (!matchFound && !q.empty() ) {
-          inStr = string(q.begin(), q.end() );
-    
-          // Check in Existing states
-          for (int j = 0; j < states.size(); j++) {
-            if (inStr == states[j]._data) {
-              _transitions[i][col] = j;
-
-              matchFound = true;
-              break;
-            }
-          }
-
-          q.pop_front();
-        }
-
-      }
-    }
-  }
-
-
-}
-
-bool Automaton::run(string input) {
-  // Always Start at Initial State
-  int stateNo = 0;
-  int charIdx;
-
-  for (char c : input) {
-    // Check if Valid Character else send to trap State
-    if (_lang.find(c) == _lang.end() ) {
-      cout<<"Char '"<< c <<"'  not in Automatons Language..."<<endl;
-      cout<<"Recahed TRAP state Terminating...."<<endl;
-      return false;
-    }
-
-    // Check if Character is in the Pattern
-    auto it = patternCharsIdx.find(c);
-    if (it != patternCharsIdx.end() ) {
-      charIdx = it->second;
-      // Update State
-      stateNo = _transitions[stateNo][charIdx];
-    }
-    
-  }
-
-  // Check if SOL state reached
-  if (states[stateNo]._t == SOL) {
-    return true;
-  }
-
-  return false;
-}
-
-int main() {
-  Automaton a("ab", "bab");
-  vector<string> testStrings = {
-    "aaabbaaabb",
-    "aabbabbab"
-  };
-
-  for (string s : testStrings) {
-    bool ans = a.run(s);
-    cout<<"String : "<< s <<endl<<"Ans : "<< ans <<endl<<endl;
-  }
-  
-
-  return 0;
+#include <iostream>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <string_view>
+#include <span>
+#include <memory>
+#include <deque>
+#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include "dense_dfa.h"
+#include "parallel_dfa.h"
+#include "static_automaton.h"
+#include "tracer.h"
+#include "alloc_counter.h"
+
+using namespace std;
+
+enum StateType { INIT, BRANCH, SOL, TERM };
+
+typedef struct State {
+  string _data;
+  StateType _t;
+
+  State(string data, StateType type = BRANCH) : _data(data), _t(type) {}
+} State;
+
+void DisplayState(const State s) {
+  cout << "Data : " << s._data << endl;
+  cout << "Type : " << s._t << endl;
+}
+
+void PrintMap(unordered_map<char, int> map) {
+  cout << "[";
+  for (auto p : map) {
+    cout << "{" << p.first << " : " << p.second << "}, ";
+  }
+  cout << "]" << endl;
+}
+
+// How Automaton fills its fallback transitions
+enum BuildMethod {
+  KMP_BUILD,    // O(m * |chars|) from the prefix (failure) function
+  NAIVE_BUILD   // Compare every suffix against every state, roughly cubic
+};
+
+class Automaton {
+  unordered_set<char> _lang;
+  vector<State> states;
+  string _pattern;
+  string patternChars;
+  unordered_map<char, int> patternCharsIdx;
+
+  // Construction table over the pattern columns, one contiguous block:
+  // _transitions[state * _nCols + col]
+  vector<int> _transitions;
+  int _nCols;
+
+  // Column of every byte for the traced per-char loop, or KEEP_COL for
+  // language chars outside the pattern and TRAP_COL for bytes outside the
+  // language
+  constexpr static int KEEP_COL = -1;
+  constexpr static int TRAP_COL = -2;
+  int _byteColumn[256];
+
+  // Run table with the alphabet and trap folded in: _byteTable[state * 256 +
+  // byte] for every byte, TERM absorbing. Only built while state numbers
+  // fit the 16-bit cells, longer patterns run through _byteColumn.
+  constexpr static int MAX_BYTE_TABLE_STATES = 1 << 16;
+  vector<uint16_t> _byteTable;
+
+  // toByteDFA for runBatch and runParallel, built on first use. The tables
+  // never change after construction, so it is kept.
+  shared_ptr<const ByteDFA> _byteDFA;
+
+  int _curState;    // Current state of the stream fed so far
+  size_t _pos;      // Chars fed since the last reset
+
+  bool checkChar(char c) {
+    auto it = _lang.find(c);
+    return it != _lang.end();
+  }
+
+  void buildKMP();
+  void buildNaive();
+  void buildByteTable();
+  void feedTable(const char* data, size_t len);
+  const ByteDFA* batchDFA(size_t bytes);
+
+ public:
+  Automaton(string language, string endPattern, BuildMethod method = KMP_BUILD);
+
+  // State i stands for the first i chars of the pattern, they are only
+  // materialized here to keep construction linear in memory
+  void printStates() {
+    for (int i = 0; i < states.size(); i++) {
+      string data = (states[i]._t == TERM) ? "" : _pattern.substr(0, i);
+      DisplayState(State(data, states[i]._t));
+    }
+    cout << endl;
+  }
+
+  void printTransitions() {
+    for (int i = 0; i < states.size(); i++) {
+      cout << i << " | ";
+      for (int j = 0; j < _nCols; j++) {
+        cout << _transitions[i * _nCols + j] << ",";
+      }
+      cout << endl;
+    }
+    cout << endl;
+  }
+
+  void printPatternCharIdx() { PrintMap(this->patternCharsIdx); }
+
+  // Transition table as a DenseDFA over the pattern character columns
+  DenseDFA toDenseDFA();
+
+  // Complete byte-level table: the pattern columns plus one column for
+  // language chars outside the pattern (state kept) and one for bytes
+  // outside the language (to the absorbing TERM state)
+  ByteDFA toByteDFA();
+
+  // Report how many states a Hopcroft-minimized table needs
+  void printMinimized();
+
+  // Runs and feeds report their steps to a tracer (see tracer.h), the
+  // overloads without one use NullTracer and do no tracing at all
+  //
+  // The untraced overloads walk _byteTable, one load per byte and no
+  // branches. The traced ones go char by char through _byteColumn.
+  template<class Tracer>
+  bool run(string_view input, Tracer& tracer);
+  bool run(string_view input) { reset(); feedTable(input.data(), input.size()); return finish(); }
+  bool run(const char* data, size_t len) { return run(string_view(data, len)); }
+
+  // Streaming interface: feed() may be called any number of times with
+  // consecutive chunks of one input, finish() reports whether the whole
+  // input is accepted and resets for the next one
+  void reset() { _curState = 0; _pos = 0; }
+  template<class Tracer>
+  void feed(const char* data, size_t len, Tracer& tracer);
+  void feed(const char* data, size_t len) { feedTable(data, len); }
+  bool finish();
+
+  // Chunk-parallel run over state maps (see parallel_dfa.h), independent
+  // of the streaming state. Inputs small next to the table just run().
+  bool runParallel(string_view input, int threads);
+
+  // out[i] = run(inputs[i]) for a whole batch, inputs interleaved per thread
+  // (see parallel_dfa.h), independent of the streaming state. Batches small
+  // next to the table just loop over run().
+  void runBatch(span<const string_view> inputs, bool* out, int threads = 1);
+};
+
+Automaton::Automaton(string language, string endPattern, BuildMethod method) {
+  _lang = unordered_set<char>(language.begin(), language.end());
+  _pattern = endPattern;
+  _curState = 0;
+  _pos = 0;
+
+  // Create Initial State
+  states.push_back(State("", INIT));
+
+  // Add States Based on the Pattern
+  for (int i = 0; i < endPattern.size(); i++) {
+    states.push_back(State(""));
+  }
+
+  states.back()._t = SOL;
+
+  // Add terminate State for sys Faults
+  states.push_back(State("", TERM) );
+
+  // get the Unique Characters Required in the end Pattern
+  for (char c : endPattern) {
+    auto it = patternCharsIdx.find(c);
+    if (it == patternCharsIdx.end()) {
+      patternCharsIdx.insert({c, patternCharsIdx.size()});
+      patternChars.push_back(c);
+    }
+  }
+
+  // Allocate Transition table
+  _nCols = patternChars.size();
+  _transitions = vector<int>(states.size() * _nCols);
+
+  if (method == KMP_BUILD) {
+    buildKMP();
+  }
+  else {
+    buildNaive();
+  }
+
+  for (int c = 0; c < 256; c++) {
+    char ch = (char) c;
+    auto it = patternCharsIdx.find(ch);
+    if (!checkChar(ch)) {
+      _byteColumn[c] = TRAP_COL;
+    }
+    else {
+      _byteColumn[c] = (it != patternCharsIdx.end()) ? it->second : KEEP_COL;
+    }
+  }
+
+  buildByteTable();
+}
+
+// Row i is a copy of the row of the failure state X (longest proper border
+// of the first i chars) with the forward link to i+1 patched in. X itself
+// is advanced through the table, so no failure array is needed.
+void Automaton::buildKMP() {
+  int m = _pattern.size();
+  if (m == 0) return;
+
+  _transitions[patternCharsIdx[_pattern[0]]] = 1;
+
+  int X = 0;
+  for (int i = 1; i <= m; i++) {
+    copy_n(&_transitions[X * _nCols], _nCols, &_transitions[i * _nCols]);
+
+    if (i < m) {
+      int idx = patternCharsIdx[_pattern[i]];
+      _transitions[i * _nCols + idx] = i + 1;
+      X = _transitions[X * _nCols + idx];
+    }
+  }
+}
+
+void Automaton::buildNaive() {
+  // Setup Main Transition Links
+  for (int i = 0; i < _pattern.size(); ++i) {
+    // Get the Uniq Chars Index for the Input character in the Finding Pattern
+    int idx = patternCharsIdx.find(_pattern[i])->second;
+    
+    _transitions[i * _nCols + idx] = i + 1;
+  }
+
+  // Other Transition Links
+  // Skipping First Row Since all other chars apart from first Pattern input
+  // char will result in Q0 only
+  string inStr = "";
+  bool matchFound = false;
+  for (int i = 1; i <= _pattern.length(); i++) {
+    // Put for All Unallocated States
+    for (int col = 0; col < patternChars.size(); col++) {
+      
+      if (_transitions[i * _nCols + col] == 0) {
+        inStr = _pattern.substr(0, i) + patternChars[col];
+      
+        // Check if Substrings [1:n], ... exist as states
+        // Donot consider Final Terminating Character
+        deque<char> q(inStr.begin(), inStr.end() );
+      
+        // Removing the first char since we know curr inStr doesnt exist as a State
+        q.pop_front();
+        matchFound = false;
+
+        while (!matchFound && !q.empty() ) {
+          inStr = string(q.begin(), q.end() );
+    
+          // Check in Existing states (state j is the pattern prefix of length j)
+          for (int j = 0; j <= _pattern.size(); j++) {
+            if (inStr == _pattern.substr(0, j)) {
+              _transitions[i * _nCols + col] = j;
+
+              matchFound = true;
+              break;
+            }
+          }
+
+          q.pop_front();
+        }
+
+      }
+    }
+  }
+}
+
+template<class Tracer>
+bool Automaton::run(string_view input, Tracer& tracer) {
+  reset();
+  feed(input.data(), input.size(), tracer);
+
+  if constexpr (Tracer::enabled) {
+    TraceKind kind = (states[_curState]._t == SOL) ? TRACE_ACCEPT : TRACE_REJECT;
+    tracer.OnEvent({kind, _pos, '\0', _curState, _curState, -1});
+  }
+
+  return finish();
+}
+
+template<class Tracer>
+void Automaton::feed(const char* data, size_t len, Tracer& tracer) {
+  // The TERM state is the last one and absorbs the rest of the stream
+  int trap = states.size() - 1;
+
+  for (size_t i = 0; i < len && _curState != trap; i++, _pos++) {
+    char c = data[i];
+    int col = _byteColumn[(unsigned char) c];
+
+    // Check if Valid Character else send to trap State
+    if (col == TRAP_COL) {
+      if constexpr (Tracer::enabled) {
+        tracer.OnEvent({TRACE_TRAP, _pos, c, _curState, trap, -1});
+      }
+      _curState = trap;
+      break;
+    }
+
+    // Check if Character is in the Pattern
+    if (col != KEEP_COL) {
+      // Update State
+      int next = _transitions[_curState * _nCols + col];
+      if constexpr (Tracer::enabled) {
+        tracer.OnEvent({TRACE_STEP, _pos, c, _curState, next, -1});
+      }
+      _curState = next;
+    }
+  }
+}
+
+// Expands the pattern columns to all 256 bytes
+void Automaton::buildByteTable() {
+  if (states.size() > MAX_BYTE_TABLE_STATES) return;
+
+  int trap = states.size() - 1;
+  _byteTable.resize(states.size() * 256);
+  for (int i = 0; i < states.size(); i++) {
+    uint16_t* row = &_byteTable[i * 256];
+    for (int c = 0; c < 256; c++) {
+      int col = _byteColumn[c];
+      if (i == trap || col == TRAP_COL) {
+        row[c] = trap;
+      }
+      else {
+        row[c] = (col == KEEP_COL) ? i : _transitions[i * _nCols + col];
+      }
+    }
+  }
+}
+
+void Automaton::feedTable(const char* data, size_t len) {
+  if (_byteTable.empty()) {
+    NullTracer t;
+    feed(data, len, t);
+    return;
+  }
+
+  const uint16_t* table = _byteTable.data();
+  const unsigned char* in = (const unsigned char*) data;
+  int state = _curState;
+  for (size_t i = 0; i < len; i++) {
+    state = table[state * 256 + in[i]];
+  }
+  _curState = state;
+  _pos += len;
+}
+
+bool Automaton::finish() {
+  // If reached Solution State the input is accepted
+  bool ans = (states[_curState]._t == SOL);
+  reset();
+  return ans;
+}
+
+DenseDFA Automaton::toDenseDFA() {
+  DenseDFA dfa(states.size(), _nCols, 0);
+
+  for (int i = 0; i < states.size(); i++) {
+    dfa.accepting[i] = (states[i]._t == SOL);
+  }
+  dfa.table = _transitions;
+
+  return dfa;
+}
+
+ByteDFA Automaton::toByteDFA() {
+  int keepCol = _nCols;
+  int trapCol = _nCols + 1;
+  int trap = states.size() - 1;
+
+  ByteDFA b;
+  b.dfa = DenseDFA(states.size(), _nCols + 2, 0);
+  for (int i = 0; i < states.size(); i++) {
+    b.dfa.accepting[i] = (states[i]._t == SOL);
+    for (int j = 0; j < _nCols; j++) {
+      b.dfa.table[i * b.dfa.nSymbols + j] = (i == trap) ? trap : _transitions[i * _nCols + j];
+    }
+    b.dfa.table[i * b.dfa.nSymbols + keepCol] = i;
+    b.dfa.table[i * b.dfa.nSymbols + trapCol] = trap;
+  }
+
+  for (int c = 0; c < 256; c++) {
+    int col = _byteColumn[c];
+    b.byteClass[c] = (col == TRAP_COL) ? trapCol : (col == KEEP_COL) ? keepCol : col;
+  }
+
+  return b;
+}
+
+// Cached ByteDFA for a run over 'bytes' of input, or nullptr when building
+// it would take longer than just running the input
+const ByteDFA* Automaton::batchDFA(size_t bytes) {
+  if (!_byteDFA) {
+    if (bytes < states.size() * (_nCols + 2)) return nullptr;
+    _byteDFA = make_shared<const ByteDFA>(toByteDFA());
+  }
+  return _byteDFA.get();
+}
+
+bool Automaton::runParallel(string_view input, int threads) {
+  const ByteDFA* b = batchDFA(input.size());
+  if (!b) return run(input);
+  int end = RunParallel(*b, input.data(), input.size(), threads);
+  return b->dfa.accepting[end];
+}
+
+void Automaton::runBatch(span<const string_view> inputs, bool* out, int threads) {
+  size_t bytes = 0;
+  for (string_view in : inputs) bytes += in.size();
+
+  const ByteDFA* b = batchDFA(bytes);
+  if (!b) {
+    for (size_t i = 0; i < inputs.size(); i++) out[i] = run(inputs[i]);
+    return;
+  }
+  RunBatch(*b, inputs, out, threads);
+}
+
+void Automaton::printMinimized() {
+  MinimizedDFA minimal = MinimizeDFA(toDenseDFA());
+
+  cout << "States : " << states.size() << " -> Minimal : " << minimal.dfa.nStates << endl;
+  for (int i = 0; i < minimal.stateMap.size(); i++) {
+    cout << "   " << i << " -> ";
+    if (minimal.stateMap[i] == -1) {
+      cout << "unreachable" << endl;
+    }
+    else {
+      cout << minimal.stateMap[i] << endl;
+    }
+  }
+  cout << endl;
+}
+
+// Aho-Corasick automaton answering "which of these patterns does the input
+// end with" in one pass. Trie nodes are states, failure links are found by
+// BFS. For alphabets up to DENSE_ALPHABET_LIMIT the failure links are folded
+// into a dense goto table (one lookup per char), larger alphabets keep the
+// sparse trie edges and follow failure links while running.
+class MultiSuffixAutomaton {
+  constexpr static int DENSE_ALPHABET_LIMIT = 64;
+
+  vector<string> _patterns;
+  int _charIdx[256];        // Column of each byte, -1 if not in the language
+  int _nSymbols;
+  bool _dense;
+
+  vector<unordered_map<int, int>> _children;   // Trie edges
+  vector<int> _fail;
+  vector<int> _goto;        // Dense: _goto[node * _nSymbols + col]
+  vector<vector<int>> _ends;   // Patterns ending exactly at node
+  vector<int> _dictLink;    // Nearest failure ancestor with patterns, -1 if none
+
+  int step(int node, int col);
+
+ public:
+  MultiSuffixAutomaton(string language, const vector<string>& endPatterns);
+
+  int stateCount() { return _fail.size(); }
+
+  // IDs (indices into endPatterns) of every pattern the input ends with,
+  // in increasing order. Empty if a char is outside the language.
+  vector<int> run(string_view input);
+  vector<int> run(const char* data, size_t len) { return run(string_view(data, len)); }
+};
+
+MultiSuffixAutomaton::MultiSuffixAutomaton(string language, const vector<string>& endPatterns) {
+  _patterns = endPatterns;
+
+  for (int i = 0; i < 256; i++) _charIdx[i] = -1;
+  _nSymbols = 0;
+  for (char c : language) {
+    if (_charIdx[(unsigned char) c] == -1) {
+      _charIdx[(unsigned char) c] = _nSymbols++;
+    }
+  }
+  _dense = (_nSymbols <= DENSE_ALPHABET_LIMIT);
+
+  // Build the trie, Root is node 0
+  _children.push_back(unordered_map<int, int>());
+  _ends.push_back(vector<int>());
+
+  for (int p = 0; p < endPatterns.size(); p++) {
+    int node = 0;
+    bool valid = true;
+
+    for (char c : endPatterns[p]) {
+      int col = _charIdx[(unsigned char) c];
+      // A pattern using chars outside the language can never match
+      if (col == -1) {
+        valid = false;
+        break;
+      }
+
+      auto it = _children[node].find(col);
+      if (it == _children[node].end()) {
+        _children[node][col] = _children.size();
+        node = _children.size();
+        _children.push_back(unordered_map<int, int>());
+        _ends.push_back(vector<int>());
+      }
+      else {
+        node = it->second;
+      }
+    }
+
+    if (valid) _ends[node].push_back(p);
+  }
+
+  // Failure and dictionary links by BFS, parents before children
+  int nNodes = _children.size();
+  _fail.assign(nNodes, 0);
+  _dictLink.assign(nNodes, -1);
+  if (_dense) _goto.assign(nNodes * _nSymbols, 0);
+
+  queue<int> q;
+  q.push(0);
+  while (!q.empty()) {
+    int node = q.front();
+    q.pop();
+
+    if (_dense) {
+      // Missing edges fall back to the failure state's (complete) row
+      for (int col = 0; col < _nSymbols; col++) {
+        _goto[node * _nSymbols + col] = (node == 0) ? 0 : _goto[_fail[node] * _nSymbols + col];
+      }
+    }
+
+    for (auto& edge : _children[node]) {
+      int col = edge.first;
+      int child = edge.second;
+
+      if (node != 0) {
+        _fail[child] = step(_fail[node], col);
+      }
+      int f = _fail[child];
+      _dictLink[child] = _ends[f].empty() ? _dictLink[f] : f;
+
+      if (_dense) _goto[node * _nSymbols + col] = child;
+      q.push(child);
+    }
+  }
+}
+
+int MultiSuffixAutomaton::step(int node, int col) {
+  if (_dense) {
+    return _goto[node * _nSymbols + col];
+  }
+
+  while (true) {
+    auto it = _children[node].find(col);
+    if (it != _children[node].end()) return it->second;
+    if (node == 0) return 0;
+    node = _fail[node];
+  }
+}
+
+vector<int> MultiSuffixAutomaton::run(string_view input) {
+  int node = 0;
+
+  for (char c : input) {
+    int col = _charIdx[(unsigned char) c];
+    if (col == -1) {
+      return vector<int>();
+    }
+    node = step(node, col);
+  }
+
+  // Every pattern that is a suffix of the state's string
+  vector<int> ans;
+  for (int n = node; n != -1; n = _dictLink[n]) {
+    ans.insert(ans.end(), _ends[n].begin(), _ends[n].end());
+  }
+  sort(ans.begin(), ans.end());
+  return ans;
+}
+
+// Construction time of both build methods for growing pattern lengths
+void RunBenchmarks() {
+  mt19937 rng(7);
+  cout << "Construction benchmark (language \"ab\")" << endl;
+  cout << "=====================================" << endl;
+
+  for (int len : {10, 100, 300, 1000, 10000, 100000}) {
+    string pattern;
+    for (int i = 0; i < len; i++) pattern += (rng() & 1) ? 'a' : 'b';
+
+    auto t0 = chrono::steady_clock::now();
+    Automaton kmp("ab", pattern, KMP_BUILD);
+    auto t1 = chrono::steady_clock::now();
+    cout << "Length " << len << " : KMP "
+         << chrono::duration<double, milli>(t1 - t0).count() << " ms";
+
+    // The naive build is roughly cubic, only time it on short patterns
+    if (len <= 300) {
+      Automaton naive("ab", pattern, NAIVE_BUILD);
+      auto t2 = chrono::steady_clock::now();
+      cout << " | Naive " << chrono::duration<double, milli>(t2 - t1).count() << " ms"
+           << (naive.toDenseDFA().table == kmp.toDenseDFA().table ? " (same table)" : " (TABLES DIFFER)");
+    }
+    cout << endl;
+  }
+}
+
+// Heap allocations per run call on short records: passing a std::string by
+// value (the old signature) against the string_view API
+void RunAllocationBenchmark() {
+  Automaton a("ab", "bab");
+  vector<string> records;
+  mt19937 rng(13);
+  for (int i = 0; i < 100000; i++) {
+    string record;
+    for (int j = 0; j < 40; j++) record += (rng() & 1) ? 'a' : 'b';
+    records.push_back(record);
+  }
+
+  auto runByValue = [&](string input) { return a.run(input); };
+
+  cout << endl << "Allocation benchmark : " << records.size() << " records of 40 chars" << endl;
+  cout << "==============================================" << endl;
+
+  int matches = 0;
+  size_t a0 = AllocationCount();
+  auto t0 = chrono::steady_clock::now();
+  for (const string& r : records) matches += runByValue(r);
+  auto t1 = chrono::steady_clock::now();
+  size_t a1 = AllocationCount();
+  for (const string& r : records) matches += a.run(r);
+  auto t2 = chrono::steady_clock::now();
+  size_t a2 = AllocationCount();
+
+  cout << "string by value : " << (double) (a1 - a0) / records.size() << " allocs/call, "
+       << chrono::duration<double, nano>(t1 - t0).count() / records.size() << " ns/call" << endl;
+  cout << "string_view     : " << (double) (a2 - a1) / records.size() << " allocs/call, "
+       << chrono::duration<double, nano>(t2 - t1).count() / records.size() << " ns/call" << endl;
+  cout << "(" << matches << " matches)" << endl;
+}
+
+// Per-char column lookups (the traced loop, run with NullTracer) against
+// the flat byte table on 16M chars
+void RunTableBenchmark() {
+  mt19937 rng(29);
+  string input;
+  input.reserve(1 << 24);
+  while (input.size() < (1 << 24)) input += "abc"[rng() % 3];
+
+  cout << endl << "Run table benchmark : 16M chars over \"abc\"" << endl;
+  cout << "==========================================" << endl;
+
+  for (int len : {3, 1000, 70000}) {
+    string pattern;
+    for (int i = 0; i < len; i++) pattern += (rng() & 1) ? 'a' : 'b';
+    Automaton a("abc", pattern);
+
+    NullTracer quiet;
+    auto t0 = chrono::steady_clock::now();
+    bool columns = a.run(input, quiet);
+    auto t1 = chrono::steady_clock::now();
+    bool table = a.run(input);
+    auto t2 = chrono::steady_clock::now();
+
+    double ms1 = chrono::duration<double, milli>(t1 - t0).count();
+    double ms2 = chrono::duration<double, milli>(t2 - t1).count();
+    cout << "Pattern " << len << " : columns " << ms1 << " ms | byte table " << ms2 << " ms ("
+         << ms1 / ms2 << "x)" << (columns == table ? "" : " RESULTS DIFFER") << endl;
+  }
+}
+
+// Serial run against the chunk-parallel run on one large input
+void RunParallelBenchmark() {
+  mt19937 rng(17);
+  string input;
+  input.reserve(1 << 26);
+  while (input.size() < (1 << 26)) input += (rng() & 1) ? 'a' : 'b';
+  input += "bab";
+
+  cout << endl << "Parallel benchmark : 64M chars, pattern \"bab\"" << endl;
+  cout << "=============================================" << endl;
+
+  Automaton a("ab", "bab");
+  auto t0 = chrono::steady_clock::now();
+  bool serial = a.run(input);
+  auto t1 = chrono::steady_clock::now();
+  double serialMs = chrono::duration<double, milli>(t1 - t0).count();
+  cout << "serial    : " << serialMs << " ms" << endl;
+
+  int hw = max(1u, thread::hardware_concurrency());
+  for (int threads = 1; threads <= 2 * hw; threads *= 2) {
+    auto t2 = chrono::steady_clock::now();
+    bool parallel = a.runParallel(input, threads);
+    auto t3 = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(t3 - t2).count();
+    cout << threads << " threads : " << ms << " ms (" << serialMs / ms << "x)"
+         << (parallel == serial ? "" : " RESULTS DIFFER") << endl;
+  }
+}
+
+// Strings per second for 1M short inputs: one run() per string against
+// the interleaved batch, single and multi-threaded
+void RunBatchBenchmark() {
+  mt19937 rng(19);
+  Automaton a("ab", "bab");
+  vector<string> records;
+  for (int i = 0; i < 1000000; i++) {
+    int len = 8 + rng() % 57;
+    string record;
+    for (int j = 0; j < len; j++) record += (rng() & 1) ? 'a' : 'b';
+    records.push_back(record);
+  }
+  vector<string_view> views(records.begin(), records.end());
+  vector<bool> expected(views.size());
+  unique_ptr<bool[]> out(new bool[views.size()]);
+
+  cout << endl << "Batch benchmark : 1M strings of 8-64 chars" << endl;
+  cout << "==========================================" << endl;
+
+  auto t0 = chrono::steady_clock::now();
+  for (size_t i = 0; i < views.size(); i++) expected[i] = a.run(views[i]);
+  auto t1 = chrono::steady_clock::now();
+  double sec = chrono::duration<double>(t1 - t0).count();
+  cout << "run() each  : " << views.size() / sec / 1e6 << " M strings/s" << endl;
+
+  int hw = max(1u, thread::hardware_concurrency());
+  for (int threads : {1, hw}) {
+    auto t2 = chrono::steady_clock::now();
+    a.runBatch(views, out.get(), threads);
+    auto t3 = chrono::steady_clock::now();
+    double s = chrono::duration<double>(t3 - t2).count();
+    bool same = equal(expected.begin(), expected.end(), out.get());
+    cout << "runBatch " << threads << "t : " << views.size() / s / 1e6 << " M strings/s"
+         << (same ? "" : " RESULTS DIFFER") << endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && string(argv[1]) == "--bench") {
+    RunBenchmarks();
+    RunAllocationBenchmark();
+    RunTableBenchmark();
+    RunParallelBenchmark();
+    RunBatchBenchmark();
+    return 0;
+  }
+
+  // --dump <language> <pattern> <file> : run table in the text form read by dfa_codegen
+  if (argc > 4 && string(argv[1]) == "--dump") {
+    ofstream out(argv[4]);
+    WriteByteDFA(out, Automaton(argv[2], argv[3]).toByteDFA());
+    return 0;
+  }
+
+  // --image <language> <pattern> <file> : binary run table for dfa_run
+  if (argc > 4 && string(argv[1]) == "--image") {
+    ofstream out(argv[4], ios::binary);
+    return WriteByteDFAImage(out, Automaton(argv[2], argv[3]).toByteDFA()) ? 0 : 1;
+  }
+
+  Automaton a("ab", "bab");
+  vector<string> testStrings = {
+    "aaabbaaabb",
+    "aabbabbab"
+  };
+
+  a.printMinimized();
+
+  for (string s : testStrings) {
+    bool ans = a.run(s);
+    cout<<"String : "<< s <<endl<<"Ans : "<< ans <<endl<<endl;
+  }
+
+  // Same input delivered in 3 char chunks
+  string stream = testStrings[1];
+  for (size_t i = 0; i < stream.size(); i += 3) {
+    a.feed(stream.data() + i, min((size_t) 3, stream.size() - i));
+  }
+  cout<<"Streamed : "<< stream <<endl<<"Ans : "<< a.finish() <<endl<<endl;
+
+  // Same automaton with its table built at compile time
+  using StaticBab = StaticAutomaton<"ab", "bab">;
+  static_assert(StaticBab::Run("aabbabbab") && !StaticBab::Run("aaabbaaabb"));
+  for (string s : testStrings) {
+    cout<<"Static : "<< s <<endl<<"Ans : "<< StaticBab::Run(s) <<endl<<endl;
+  }
+
+  // All suffix patterns in one automaton
+  vector<string> extensions = {".txt", ".gz", ".tar.gz", "z", ".c", ".cc"};
+  MultiSuffixAutomaton m("abcdefghijklmnopqrstuvwxyz.", extensions);
+  vector<string> files = {"notes.txt", "src.tar.gz", "a.gz", "main.cc", "quiz", "readme"};
+
+  cout << "Suffix automaton states : " << m.stateCount() << endl;
+  for (string s : files) {
+    cout << "String : " << s << endl << "Ends with : ";
+    for (int id : m.run(s)) {
+      cout << extensions[id] << " ";
+    }
+    cout << endl << endl;
+  }
+  
+
+  return 0;
 }
\ No newline at end of file
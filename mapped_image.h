@@ -0,0 +1,163 @@
+#ifndef MAPPED_IMAGE_H
+#define MAPPED_IMAGE_H
+
+#include<cstdint>
+#include<cstring>
+#include<cstddef>
+#include<string>
+#include<vector>
+#include<iostream>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+// Binary images of compiled automata. An image is a fixed header followed by
+// sections of raw table data, each starting on a SECTION_ALIGN boundary, so
+// a file mapped with MappedFile is used in place: the automaton points into
+// the mapping and loading does no parsing, copying or allocation per entry.
+// Worker processes mapping the same file share one copy in the page cache.
+//
+// Images are native-endian; a byte-order tag in the header rejects images
+// written on a machine of the other kind, and the version rejects images of
+// an older layout. Tables are validated once on load, never trusted blindly.
+
+constexpr uint32_t IMAGE_VERSION = 2;    // 2: 32-bit pool offsets in PDA moves
+constexpr uint32_t IMAGE_BYTE_ORDER = 0x01020304;
+constexpr size_t SECTION_ALIGN = 64;
+constexpr int MAX_IMAGE_PARAMS = 16;
+constexpr int MAX_IMAGE_SECTIONS = 8;
+
+// What an image holds, checked on load
+enum ImageKind : uint32_t {
+    IMAGE_PDA = 1,
+    IMAGE_BYTE_DFA = 2
+};
+
+struct ImageSection {
+    uint64_t offset;    // From the start of the image, SECTION_ALIGN aligned
+    uint64_t bytes;
+};
+
+struct ImageHeader {
+    char magic[8];                                  // "AUTOIMG"
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t kind;
+    uint32_t nSections;
+    uint64_t imageBytes;                            // Whole image, header included
+    int64_t params[MAX_IMAGE_PARAMS];               // Scalars, meaning depends on kind
+    ImageSection sections[MAX_IMAGE_SECTIONS];
+};
+
+// Collects the scalars and sections of one image and writes it out. The
+// sections are not copied, they must stay alive until Write.
+class ImageWriter {
+    ImageHeader header;
+    std::vector<const void*> data;
+
+public:
+    ImageWriter(ImageKind kind) {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "AUTOIMG", 8);
+        header.version = IMAGE_VERSION;
+        header.byteOrder = IMAGE_BYTE_ORDER;
+        header.kind = kind;
+    }
+
+    void SetParam(int i, int64_t value) {
+        header.params[i] = value;
+    }
+
+    void AddSection(const void* bytes, size_t size) {
+        header.sections[header.nSections++] = {0, size};
+        data.push_back(bytes);
+    }
+
+    bool Write(std::ostream& out) {
+        uint64_t offset = (sizeof(ImageHeader) + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+        for (uint32_t i = 0; i < header.nSections; i++) {
+            header.sections[i].offset = offset;
+            offset += (header.sections[i].bytes + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+        }
+        header.imageBytes = offset;
+
+        static const char padding[SECTION_ALIGN] = {};
+        out.write((const char*) &header, sizeof(header));
+        uint64_t written = sizeof(header);
+        for (uint32_t i = 0; i < header.nSections; i++) {
+            out.write(padding, header.sections[i].offset - written);
+            out.write((const char*) data[i], header.sections[i].bytes);
+            written = header.sections[i].offset + header.sections[i].bytes;
+        }
+        out.write(padding, header.imageBytes - written);
+        return (bool) out;
+    }
+};
+
+// Header of a well-formed image of 'kind' with 'sections' sections, or
+// nullptr. Only the framing is checked here; callers check the tables.
+inline const ImageHeader* ReadImageHeader(const void* image, size_t size, ImageKind kind, uint32_t sections) {
+    if (size < sizeof(ImageHeader) || (uintptr_t) image % SECTION_ALIGN != 0) return nullptr;
+    const ImageHeader* h = (const ImageHeader*) image;
+    if (std::memcmp(h->magic, "AUTOIMG", 8) != 0 || h->version != IMAGE_VERSION ||
+        h->byteOrder != IMAGE_BYTE_ORDER || h->kind != kind || h->nSections != sections ||
+        h->imageBytes != size) {
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < sections; i++) {
+        const ImageSection& s = h->sections[i];
+        if (s.offset % SECTION_ALIGN != 0 || s.offset < sizeof(ImageHeader) ||
+            s.offset > size || s.bytes > size - s.offset) {
+            return nullptr;
+        }
+    }
+    return h;
+}
+
+// Section i viewed as an array of T, its element count in 'count'
+template<class T>
+const T* ImageSectionData(const ImageHeader* h, int i, size_t& count) {
+    count = h->sections[i].bytes / sizeof(T);
+    return (const T*) ((const char*) h + h->sections[i].offset);
+}
+
+// Read-only private mapping of a whole file, unmapped on destruction
+class MappedFile {
+    void* base;
+    size_t length;
+
+public:
+    MappedFile() : base(nullptr), length(0) {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string& path) {
+        Close();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        base = p;
+        length = st.st_size;
+        return true;
+    }
+
+    void Close() {
+        if (base) munmap(base, length);
+        base = nullptr;
+        length = 0;
+    }
+
+    const void* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+#endif
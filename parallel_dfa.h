@@ -0,0 +1,203 @@
+#ifndef PARALLEL_DFA_H
+#define PARALLEL_DFA_H
+
+#include<vector>
+#include<thread>
+#include<algorithm>
+#include<span>
+#include<string_view>
+#include "dense_dfa.h"
+
+// Chunk-parallel DFA runs by state-mapping speculation. The first chunk runs
+// from the start state as usual. Every other chunk is run from all states at
+// once, giving a map start -> end for that chunk, and the maps are applied
+// left to right afterwards. Lanes that reach the same state are merged, so
+// for most automata the speculative run quickly collapses to a single lane
+// and costs about as much as a plain run.
+
+// Smallest chunk worth handing to a thread
+const size_t MIN_PARALLEL_DFA_CHUNK = 1 << 16;
+// Bytes between checks for lanes that have converged
+const size_t LANE_MERGE_INTERVAL = 64;
+
+// map[s] = state reached after running the chunk from state s
+inline std::vector<int> ChunkStateMap(const ByteDFA& b, const char* data, size_t len) {
+    int n = b.dfa.nStates;
+    int k = b.dfa.nSymbols;
+    const int* table = b.dfa.table.data();
+
+    // active[l] is the current state of lane l, lane[s] the lane of start s
+    std::vector<int> active(n), lane(n), laneOf(n, -1), remap;
+    for (int s = 0; s < n; s++) {
+        active[s] = s;
+        lane[s] = s;
+    }
+
+    size_t i = 0;
+    while (i < len && active.size() > 1) {
+        size_t end = std::min(len, i + LANE_MERGE_INTERVAL);
+        for (; i < end; i++) {
+            int col = b.byteClass[(unsigned char) data[i]];
+            for (int& s : active) {
+                s = table[s * k + col];
+            }
+        }
+
+        // Merge lanes sitting in the same state
+        remap.resize(active.size());
+        int m = 0;
+        for (size_t l = 0; l < active.size(); l++) {
+            int s = active[l];
+            if (laneOf[s] == -1) {
+                laneOf[s] = m;
+                active[m++] = s;
+            }
+            remap[l] = laneOf[s];
+        }
+        for (int l = 0; l < m; l++) {
+            laneOf[active[l]] = -1;
+        }
+        if (m < (int) active.size()) {
+            active.resize(m);
+            for (int& l : lane) {
+                l = remap[l];
+            }
+        }
+    }
+
+    // Converged, the rest of the chunk is a plain run
+    if (active.size() == 1) {
+        active[0] = b.Run(data + i, len - i, active[0]);
+    }
+
+    std::vector<int> map(n);
+    for (int s = 0; s < n; s++) {
+        map[s] = active[lane[s]];
+    }
+    return map;
+}
+
+// State reached from b.dfa.start after the whole input, using up to
+// 'threads' threads. Inputs too short to be worth the threads use fewer.
+inline int RunParallel(const ByteDFA& b, const char* data, size_t len, int threads) {
+    if (threads < 1) threads = 1;
+    if ((size_t) threads > len / MIN_PARALLEL_DFA_CHUNK) {
+        threads = std::max<size_t>(1, len / MIN_PARALLEL_DFA_CHUNK);
+    }
+
+    // Equal chunks, the last one takes the remainder
+    size_t chunk = len / threads;
+    std::vector<std::vector<int>> maps(threads);
+    auto work = [&](int t) {
+        size_t begin = t * chunk;
+        size_t n = (t == threads - 1) ? len - begin : chunk;
+        maps[t] = ChunkStateMap(b, data + begin, n);
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(work, t);
+    }
+    int state = b.Run(data, (threads == 1) ? len : chunk, b.dfa.start);
+    for (std::thread& th : pool) th.join();
+
+    for (int t = 1; t < threads; t++) {
+        state = maps[t][state];
+    }
+    return state;
+}
+
+// Batches of many short inputs are the opposite case: each input is
+// serial, but independent inputs are interleaved BATCH_LANES at a time so
+// their table lookups overlap instead of waiting on each other.
+
+const int BATCH_LANES = 8;
+// Smallest share of a batch worth handing to a thread
+const size_t MIN_BATCH_PER_THREAD = 1 << 12;
+
+// out[i] = whether inputs[i] ends in an accepting state, on this thread
+inline void RunBatchInterleaved(const ByteDFA& b, std::span<const std::string_view> inputs, bool* out) {
+    int k = b.dfa.nSymbols;
+    const int* table = b.dfa.table.data();
+    std::vector<char> accepting(b.dfa.accepting.begin(), b.dfa.accepting.end());
+
+    // Lanes 0 .. live-1 hold an input in flight
+    int state[BATCH_LANES];
+    const unsigned char* cur[BATCH_LANES];
+    const unsigned char* end[BATCH_LANES];
+    size_t id[BATCH_LANES];
+    int live = 0;
+    size_t next = 0;
+
+    auto refill = [&]() {
+        while (live < BATCH_LANES && next < inputs.size()) {
+            std::string_view in = inputs[next];
+            if (in.empty()) {
+                out[next++] = accepting[b.dfa.start];
+                continue;
+            }
+            state[live] = b.dfa.start;
+            cur[live] = (const unsigned char*) in.data();
+            end[live] = cur[live] + in.size();
+            id[live] = next++;
+            live++;
+        }
+    };
+
+    refill();
+    while (live > 0) {
+        // Every live lane has at least 'steps' bytes left, so the inner loop
+        // needs no per-lane bounds check
+        size_t steps = end[0] - cur[0];
+        for (int l = 1; l < live; l++) {
+            steps = std::min<size_t>(steps, end[l] - cur[l]);
+        }
+        for (size_t i = 0; i < steps; i++) {
+            for (int l = 0; l < live; l++) {
+                state[l] = table[state[l] * k + b.byteClass[cur[l][i]]];
+            }
+        }
+
+        // Retire finished lanes by moving the last live lane into their slot
+        for (int l = 0; l < live; l++) {
+            cur[l] += steps;
+        }
+        for (int l = 0; l < live; ) {
+            if (cur[l] != end[l]) {
+                l++;
+                continue;
+            }
+            out[id[l]] = accepting[state[l]];
+            live--;
+            state[l] = state[live];
+            cur[l] = cur[live];
+            end[l] = end[live];
+            id[l] = id[live];
+        }
+        refill();
+    }
+}
+
+// Same over up to 'threads' threads, each taking a contiguous slice
+inline void RunBatch(const ByteDFA& b, std::span<const std::string_view> inputs, bool* out, int threads) {
+    if (threads < 1) threads = 1;
+    if ((size_t) threads > inputs.size() / MIN_BATCH_PER_THREAD) {
+        threads = std::max<size_t>(1, inputs.size() / MIN_BATCH_PER_THREAD);
+    }
+
+    size_t slice = inputs.size() / threads;
+    auto work = [&](int t) {
+        size_t begin = t * slice;
+        size_t n = (t == threads - 1) ? inputs.size() - begin : slice;
+        RunBatchInterleaved(b, inputs.subspan(begin, n), out + begin);
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(work, t);
+    }
+    work(0);
+    for (std::thread& th : pool) th.join();
+}
+
+#endif
@@ -1,9 +1,20 @@
 #include<iostream>
 #include<vector>
 #include<map>
+#include<set>
 #include<unordered_map>
-#include<stack>
+#include<unordered_set>
+#include<algorithm>
 #include<string>
+#include<string_view>
+#include<sstream>
+#include<fstream>
+#include<array>
+#include<chrono>
+#include<cstdint>
+#include<stdexcept>
+#include "tracer.h"
+#include "mapped_image.h"
 
 using namespace std;
 
@@ -28,50 +39,79 @@ struct PDAState {
     PDAState(StateType t = TERM) : type(t), transitions(TransitionTable()) {}
 };
 
+// Contiguous char stack, top at the back. Peek reads k symbols deep without
+// copying, PopPush checks and applies a whole transition's pops and pushes.
+class PDAStack {
+    vector<char> symbols;
+
+public:
+    PDAStack(size_t capacity = 64) { symbols.reserve(capacity); }
+
+    bool empty() const { return symbols.empty(); }
+    size_t size() const { return symbols.size(); }
+    char top() const { return symbols.back(); }
+    void push(char c) { symbols.push_back(c); }
+    void pop() { symbols.pop_back(); }
+    void clear() { symbols.clear(); }
+
+    // k-th symbol from the top (0 is the top), k < size()
+    char Peek(size_t k) const { return symbols[symbols.size() - 1 - k]; }
+
+    // Whether the top symbols read "pops" from the top down
+    bool Matches(string_view pops) const {
+        if (pops.size() > symbols.size()) return false;
+        for (size_t k = 0; k < pops.size(); k++) {
+            if (Peek(k) != pops[k]) return false;
+        }
+        return true;
+    }
+
+    // Pop forward ("AB" pops A then B) and push backward ("AB" leaves A on
+    // top), all or nothing: false and no change if the pops do not match
+    bool PopPush(string_view pops, string_view pushs) {
+        if (!Matches(pops)) return false;
+        symbols.resize(symbols.size() - pops.size());
+        symbols.insert(symbols.end(), pushs.rbegin(), pushs.rend());
+        return true;
+    }
+};
+
 class PDA {
 private:
+    friend class CompiledPDA;
+    friend class NondeterministicPDA;
+
     map<int, PDAState> states;
-    stack<char> pdaStack;
+    PDAStack pdaStack;
     int currentState;
+    bool streamRejected;    // Feed hit a dead end, rest of the stream is ignored
     constexpr static char STACK_BOTTOM = 'Z';
     constexpr static char EPSILON = 'E';
+    // Bound on consecutive epsilon moves, guards against epsilon loops
+    constexpr static int MAX_EPSILON_RUN = 1 << 16;
     
-    // Helper function to validate and perform pop operations
-    bool TryPop(const string& pops) {
-        if (pops.empty()) return true;
+    // Take the transition for (currentState, symbol, stack top) if there is
+    // one and its pops match. The stack is left untouched otherwise.
+    bool ApplyTransition(char symbol, TransitionEntry& entry) {
+        char stackTopChar = pdaStack.empty() ? '\0' : pdaStack.top();
         
-        // Create temp stack to check if all pops are valid
-        stack<char> temp = pdaStack;
+        auto inputIt = states[currentState].transitions.find(symbol);
+        if (inputIt == states[currentState].transitions.end()) return false;
         
-        // Try to pop forward: "AB" means pop A then pop B
-        for (char c : pops) {
-            if (temp.empty() || temp.top() != c) {
-                return false;
-            }
-            temp.pop();
-        }
+        auto stackIt = inputIt->second.find(stackTopChar);
+        if (stackIt == inputIt->second.end()) return false;
         
-        // If validation succeeds, actually perform the pops
-        for (char c : pops) {
-            pdaStack.pop();
-        }
+        entry = stackIt->second;
+        if (!pdaStack.PopPush(entry.pops, entry.pushs)) return false;
         
+        currentState = entry.nextStateIdx;
         return true;
     }
     
-    // Helper function to perform push operations
-    void DoPush(const string& pushs) {
-        if (pushs.empty()) return;
-        
-        // Push backward: "AB" means push B then push A
-        for (int i = pushs.size() - 1; i >= 0; i--) {
-            pdaStack.push(pushs[i]);
-        }
-    }
-    
 public:
     PDA() {
         currentState = 0;
+        streamRejected = false;
         pdaStack.push(STACK_BOTTOM);
         InitializePDA();
     }
@@ -137,135 +177,837 @@ public:
         }
     }
     
-    bool ProcessString(const string& input) {
+    // Text form of the machine, for authoring. One declaration per line,
+    // '#' starts a comment, '-' stands for an empty field:
+    //   pda
+    //   state <id> <INIT|BRANCH|SOL|TERM>
+    //   move <from> <input|E> <stack top|-> <next> <pops|-> <pushs|->
+    // State 0 is the start state. Input E is an epsilon move, stack top '-'
+    // matches the empty stack. Symbols are single chars other than blanks,
+    // '#' and '-'.
+    void SaveText(ostream& out) const {
+        static const char* typeNames[] = {"INIT", "BRANCH", "SOL", "TERM"};
+        auto field = [](const string& s) { return s.empty() ? string("-") : s; };
+
+        out << "pda\n";
+        for (auto& p : states) {
+            out << "state " << p.first << " " << typeNames[p.second.type] << "\n";
+        }
+        for (auto& p : states) {
+            // Sorted, the hash maps have no stable order
+            vector<pair<pair<char, char>, const TransitionEntry*>> moves;
+            for (auto& in : p.second.transitions) {
+                for (auto& st : in.second) moves.push_back({{in.first, st.first}, &st.second});
+            }
+            sort(moves.begin(), moves.end());
+            for (auto& m : moves) {
+                out << "move " << p.first << " " << m.first.first << " "
+                    << (m.first.second == '\0' ? string("-") : string(1, m.first.second)) << " "
+                    << m.second->nextStateIdx << " " << field(m.second->pops) << " "
+                    << field(m.second->pushs) << "\n";
+            }
+        }
+    }
+
+    // Replaces the machine with the one read from 'in' and resets. On
+    // malformed input returns false with the reason in 'error' and leaves
+    // the current machine untouched.
+    bool LoadText(istream& in, string* error = nullptr) {
+        map<int, PDAState> loaded;
+        set<int> declared;
+        vector<pair<int, int>> targets;    // Next state of each move, line it is on
+        string line;
+        int lineNo = 0;
+        bool sawHeader = false;
+
+        auto fail = [&](const string& why) {
+            if (error) *error = "line " + to_string(lineNo) + ": " + why;
+            return false;
+        };
+        auto field = [](const string& s) { return s == "-" ? string() : s; };
+
+        while (getline(in, line)) {
+            lineNo++;
+            size_t hash = line.find('#');
+            if (hash != string::npos) line.resize(hash);
+            istringstream fields(line);
+            string kind;
+            if (!(fields >> kind)) continue;
+
+            if (!sawHeader) {
+                if (kind != "pda") return fail("expected 'pda' header");
+                sawHeader = true;
+                continue;
+            }
+
+            string extra;
+            if (kind == "state") {
+                int id;
+                string type;
+                if (!(fields >> id >> type) || (fields >> extra)) return fail("expected 'state <id> <type>'");
+                static const map<string, StateType> types = {
+                    {"INIT", INIT}, {"BRANCH", BRANCH}, {"SOL", SOL}, {"TERM", TERM}
+                };
+                auto t = types.find(type);
+                if (t == types.end()) return fail("unknown state type '" + type + "'");
+                if (!declared.insert(id).second) return fail("state " + to_string(id) + " declared twice");
+                loaded[id].type = t->second;
+            }
+            else if (kind == "move") {
+                int from, next;
+                string input, top, pops, pushs;
+                if (!(fields >> from >> input >> top >> next >> pops >> pushs) || (fields >> extra) ||
+                    input.size() != 1 || top.size() != 1) {
+                    return fail("expected 'move <from> <input> <top> <next> <pops> <pushs>'");
+                }
+                char topChar = (top == "-") ? '\0' : top[0];
+                auto& slot = loaded[from].transitions[input[0]];
+                if (!slot.insert({topChar, TransitionEntry(next, field(pops), field(pushs))}).second) {
+                    return fail("second move for the same state, input and stack top");
+                }
+                targets.push_back({next, lineNo});
+            }
+            else {
+                return fail("unknown declaration '" + kind + "'");
+            }
+        }
+
+        if (!sawHeader) return fail("expected 'pda' header");
+        for (auto& p : loaded) {
+            if (!declared.count(p.first)) return fail("moves from undeclared state " + to_string(p.first));
+        }
+        for (auto& t : targets) {
+            if (!declared.count(t.first)) {
+                lineNo = t.second;
+                return fail("move to undeclared state " + to_string(t.first));
+            }
+        }
+        if (!declared.count(0)) return fail("no start state 0");
+
+        states.swap(loaded);
+        Reset();
+        return true;
+    }
+    
+    // Input transitions take priority, epsilon transitions are only taken
+    // when no input transition applies (or the input is exhausted). A string
+    // is accepted when the SOL state is reached after all of it was read.
+    // Every move is reported to 'tracer' (see tracer.h) with the stack size.
+    template<class Tracer>
+    bool ProcessString(string_view input, Tracer& tracer) {
         // Reset PDA state
-        currentState = 0;
-        while (!pdaStack.empty()) pdaStack.pop();
-        pdaStack.push(STACK_BOTTOM);
+        Reset();
         
-        cout << "\nProcessing string: \"" << input << "\"\n";
-        cout << "================================\n";
-        
-        int inputIdx = 0;
+        size_t inputIdx = 0;
+        int epsilonRun = 0;
+        TransitionEntry entry;
         
         while (true) {
-            char stackTopChar = pdaStack.empty() ? '\0' : pdaStack.top();
-            char inputChar = (inputIdx < input.size()) ? input[inputIdx] : EPSILON;
-            
-            cout << "State: " << currentState 
-                 << " | Stack Top: " << stackTopChar 
-                 << " | Input: " << (inputChar == EPSILON ? "\u03B5" : string(1, inputChar))  // \u03B5 => ε
-                 << " | Stack Size: " << pdaStack.size() << endl;
-            
-            // Check if we're in accept state
-            if (states[currentState].type == SOL) {
-                cout << "\n\u2713 String ACCEPTED!\n";  // \u2713 => ✓
+            // Check if we're in accept state with all input read
+            if (states[currentState].type == SOL && inputIdx >= input.size()) {
+                if constexpr (Tracer::enabled) {
+                    tracer.OnEvent({TRACE_ACCEPT, inputIdx, '\0', currentState, currentState, (int) pdaStack.size()});
+                }
                 return true;
             }
             
             // Check if we're in reject state
-            if (states[currentState].type == TERM) {
-                cout << "\n\u2717 String REJECTED!\n";  // \u2717 => ✗
-                return false;
-            }
+            if (states[currentState].type == TERM) break;
             
-            // Find matching transition using tabular format
-            bool transitionFound = false;
-            TransitionEntry entry;
+            int from = currentState;
             
-            // First try epsilon transition
-            if (states[currentState].transitions.find(EPSILON) != states[currentState].transitions.end()) {
-                auto& epsilonMap = states[currentState].transitions[EPSILON];
-                if (epsilonMap.find(stackTopChar) != epsilonMap.end()) {
-                    entry = epsilonMap[stackTopChar];
-                    
-                    // Try to perform pops
-                    if (TryPop(entry.pops)) {
-                        cout << "   -> Taking epsilon transition: ";
-                        cout << "Pop[" << (entry.pops.empty() ? "\u03B5" : entry.pops) << "] ";  // \u03B5 => ε
-                        
-                        // Perform pushes
-                        DoPush(entry.pushs);
-                        cout << "Push[" << (entry.pushs.empty() ? "\u03B5" : entry.pushs) << "] ";  // \u03B5 => ε
-                        
-                        cout << "-> State " << entry.nextStateIdx << endl;
-                        currentState = entry.nextStateIdx;
-                        transitionFound = true;
-                    }
+            // First try regular input transition
+            if (inputIdx < input.size() && ApplyTransition(input[inputIdx], entry)) {
+                if constexpr (Tracer::enabled) {
+                    tracer.OnEvent({TRACE_STEP, inputIdx, input[inputIdx], from, currentState, (int) pdaStack.size()});
                 }
+                inputIdx++;
+                epsilonRun = 0;
+                continue;
             }
             
-            // If no epsilon transition, try regular input transition
-            if (!transitionFound && inputChar != EPSILON) {
-                if (states[currentState].transitions.find(inputChar) != states[currentState].transitions.end()) {
-                    auto& inputMap = states[currentState].transitions[inputChar];
-                    if (inputMap.find(stackTopChar) != inputMap.end()) {
-                        entry = inputMap[stackTopChar];
-                        
-                        // Try to perform pops
-                        if (TryPop(entry.pops)) {
-                            cout << "   -> Transition found: ";
-                            cout << "Pop[" << (entry.pops.empty() ? "\u03B5" : entry.pops) << "] ";  // \u03B5 => ε
-                            
-                            // Perform pushes
-                            DoPush(entry.pushs);
-                            cout << "Push[" << (entry.pushs.empty() ? "\u03B5" : entry.pushs) << "] ";  // \u03B5 => ε
-                            
-                            cout << "-> State " << entry.nextStateIdx << endl;
-                            currentState = entry.nextStateIdx;
-                            inputIdx++;
-                            transitionFound = true;
-                        }
-                        else {
-                            cout << "   -> Pop validation failed!\n";
-                        }
-                    }
+            // Otherwise fall back to an epsilon transition
+            if (epsilonRun++ < MAX_EPSILON_RUN && ApplyTransition(EPSILON, entry)) {
+                if constexpr (Tracer::enabled) {
+                    tracer.OnEvent({TRACE_EPSILON, inputIdx, EPSILON, from, currentState, (int) pdaStack.size()});
                 }
+                continue;
             }
             
             // No transition found
-            if (!transitionFound) {
-                // Check for end of input
-                if (inputIdx >= input.size()) {
-                    // Try epsilon transition one more time for accept
-                    if (states[currentState].transitions.find(EPSILON) != states[currentState].transitions.end()) {
-                        auto& epsilonMap = states[currentState].transitions[EPSILON];
-                        if (epsilonMap.find(stackTopChar) != epsilonMap.end()) {
-                            entry = epsilonMap[stackTopChar];
-                            if (TryPop(entry.pops)) {
-                                DoPush(entry.pushs);
-                                currentState = entry.nextStateIdx;
-                                
-                                if (states[currentState].type == SOL) {
-                                    cout << "\n\u2713 String ACCEPTED!\n";  // \u2713 => ✓
-                                    return true;
-                                }
-                            }
-                        }
-                    }
+            break;
+        }
+        
+        if constexpr (Tracer::enabled) {
+            tracer.OnEvent({TRACE_REJECT, inputIdx, '\0', currentState, currentState, (int) pdaStack.size()});
+        }
+        return false;
+    }
+    
+    bool ProcessString(string_view input) {
+        NullTracer tracer;
+        return ProcessString(input, tracer);
+    }
+    
+    // Streaming interface: Feed may be called any number of times with
+    // consecutive chunks of one input, the state and stack carry over.
+    // Finish takes the closing epsilon moves, reports acceptance and resets.
+    // ProcessString shares the same state, call Reset after using it.
+    void Reset() {
+        currentState = 0;
+        streamRejected = false;
+        pdaStack.clear();
+        pdaStack.push(STACK_BOTTOM);
+    }
+    
+    void Feed(const char* data, size_t len) {
+        TransitionEntry entry;
+        
+        for (size_t i = 0; i < len && !streamRejected; i++) {
+            int epsilonRun = 0;
+            
+            // Epsilon moves until the char can be consumed
+            while (!ApplyTransition(data[i], entry)) {
+                if (states[currentState].type == TERM || epsilonRun++ >= MAX_EPSILON_RUN ||
+                    !ApplyTransition(EPSILON, entry)) {
+                    streamRejected = true;
+                    break;
                 }
-                
-                cout << "   -> No valid transition found!\n";
-                cout << "\n\u2717 String REJECTED!\n";  // \u2717 => ✗
-                return false;
             }
+            
+            if (states[currentState].type == TERM) streamRejected = true;
+        }
+    }
+    
+    bool Finish() {
+        TransitionEntry entry;
+        int epsilonRun = 0;
+        
+        if (!streamRejected) {
+            while (states[currentState].type != SOL && states[currentState].type != TERM &&
+                   epsilonRun++ < MAX_EPSILON_RUN && ApplyTransition(EPSILON, entry)) {}
         }
         
-        return false;
+        bool accepted = !streamRejected && states[currentState].type == SOL;
+        Reset();
+        return accepted;
     }
     
     void DisplayStack() {
         cout << "Stack Contents (top to bottom): ";
-        stack<char> temp = pdaStack;
-        while (!temp.empty()) {
-            cout << temp.top() << " ";
-            temp.pop();
+        for (size_t k = 0; k < pdaStack.size(); k++) {
+            cout << pdaStack.Peek(k) << " ";
         }
         cout << endl;
     }
 };
 
-int main() {
+// Deterministic PDA compiled to flat arrays. States, input chars and stack
+// symbols are renumbered densely, and one move table indexed
+// [state][input][stackTop] replaces the nested hash lookups. The stack holds
+// symbol indices in a preallocated vector; pops and pushes are slices of
+// one shared symbol pool. Same acceptance rules as PDA::ProcessString.
+// The tables can be written out as an image (mapped_image.h) and used
+// straight from a mapped file, so deployed machines load without parsing.
+class CompiledPDA {
+    // One cell of the move table, next == -1 when there is no move
+    struct Move {
+        int32_t next;
+        uint32_t popOff, popLen;
+        uint32_t pushOff, pushLen;    // Stored in push order, top last
+    };
+    static_assert(sizeof(Move) == 20, "Move is stored as is in PDA images");
+
+    int nStates, nInputs, nStack;
+    int start, epsilon;               // epsilon is the last input column
+    int emptyTop;                     // stack column used when the stack is empty
+    int bottom;                       // index of STACK_BOTTOM
+    size_t nMoves, poolSize;
+
+    // Tables, pointing into the vectors below or into a mapped image
+    const Move* moves;                // [(state * nInputs + input) * nStack + top]
+    const uint8_t* pool;
+    const uint8_t* stateType;
+    const int16_t* inputIdx;          // byte -> input column, -1 if never read
+    const char* stackChar;            // index -> stack symbol, for tracing
+
+    vector<Move> moveStore;
+    vector<uint8_t> poolStore;
+    vector<uint8_t> typeStore;
+    vector<int16_t> inputStore;
+    vector<char> stackCharStore;
+
+    vector<uint8_t> stackBuf;
+    size_t stackSize;
+
+    const Move& At(int state, int input, int top) const {
+        return moves[((size_t) state * nInputs + input) * nStack + top];
+    }
+
+    // Applies the move if its pops match, like PDAStack::PopPush
+    bool Apply(const Move& m, int& state) {
+        if (m.next < 0 || m.popLen > stackSize) return false;
+        const uint8_t* pops = &pool[m.popOff];
+        for (uint32_t k = 0; k < m.popLen; k++) {
+            if (stackBuf[stackSize - 1 - k] != pops[k]) return false;
+        }
+        stackSize -= m.popLen;
+        if (stackSize + m.pushLen > stackBuf.size()) {
+            stackBuf.resize(2 * (stackSize + m.pushLen));
+        }
+        for (uint32_t k = 0; k < m.pushLen; k++) {
+            stackBuf[stackSize++] = pool[m.pushOff + k];
+        }
+        state = m.next;
+        return true;
+    }
+
+public:
+    // Throws range_error if a move leads to an undefined state, or if the
+    // machine's pops and pushes do not fit the 32-bit offsets of the move table
+    CompiledPDA(const PDA& pda) {
+        // Dense numbering of states, input chars and stack symbols
+        map<int, int> stateIdx;
+        for (auto& p : pda.states) {
+            stateIdx.insert({p.first, (int) stateIdx.size()});
+        }
+        map<char, int> inputs, stackSyms;
+        auto stackSym = [&](char c) {
+            return stackSyms.insert({c, (int) stackSyms.size()}).first->second;
+        };
+        stackSym(PDA::STACK_BOTTOM);
+        for (auto& p : pda.states) {
+            for (auto& in : p.second.transitions) {
+                if (in.first != PDA::EPSILON) inputs.insert({in.first, (int) inputs.size()});
+                for (auto& st : in.second) {
+                    if (st.first != '\0') stackSym(st.first);
+                    for (char c : st.second.pops) stackSym(c);
+                    for (char c : st.second.pushs) stackSym(c);
+                }
+            }
+        }
+
+        nStates = stateIdx.size();
+        nInputs = inputs.size() + 1;
+        epsilon = nInputs - 1;
+        nStack = stackSyms.size() + 1;
+        emptyTop = nStack - 1;
+        bottom = stackSyms[PDA::STACK_BOTTOM];
+        start = stateIdx.count(0) ? stateIdx[0] : 0;
+
+        inputStore.assign(256, -1);
+        for (auto& in : inputs) inputStore[(unsigned char) in.first] = in.second;
+        // PDA looks input chars up by value, so an input EPSILON char takes
+        // the epsilon moves; kept for identical results
+        inputStore[(unsigned char) PDA::EPSILON] = epsilon;
+        stackCharStore.assign(nStack, '\0');
+        for (auto& st : stackSyms) stackCharStore[st.second] = st.first;
+
+        typeStore.resize(nStates);
+        moveStore.assign((size_t) nStates * nInputs * nStack, Move{-1, 0, 0, 0, 0});
+        for (auto& p : pda.states) {
+            int s = stateIdx[p.first];
+            typeStore[s] = p.second.type;
+            for (auto& in : p.second.transitions) {
+                int i = (in.first == PDA::EPSILON) ? epsilon : inputs[in.first];
+                for (auto& st : in.second) {
+                    const TransitionEntry& e = st.second;
+                    int top = (st.first == '\0') ? emptyTop : stackSyms[st.first];
+
+                    // LoadText rejects these; PDAs built in code may still have them
+                    auto next = stateIdx.find(e.nextStateIdx);
+                    if (next == stateIdx.end()) {
+                        throw range_error("PDA move into undefined state " + to_string(e.nextStateIdx));
+                    }
+
+                    // Offsets and lengths must fit the Move fields
+                    if (poolStore.size() + e.pops.size() + e.pushs.size() > UINT32_MAX) {
+                        throw range_error("PDA pops and pushes exceed the compiled symbol pool");
+                    }
+
+                    Move m;
+                    m.next = next->second;
+                    m.popOff = poolStore.size();
+                    m.popLen = e.pops.size();
+                    for (char c : e.pops) poolStore.push_back(stackSyms[c]);
+                    m.pushOff = poolStore.size();
+                    m.pushLen = e.pushs.size();
+                    for (auto it = e.pushs.rbegin(); it != e.pushs.rend(); ++it) {
+                        poolStore.push_back(stackSyms[*it]);
+                    }
+                    moveStore[((size_t) s * nInputs + i) * nStack + top] = m;
+                }
+            }
+        }
+
+        nMoves = moveStore.size();
+        poolSize = poolStore.size();
+        moves = moveStore.data();
+        pool = poolStore.data();
+        stateType = typeStore.data();
+        inputIdx = inputStore.data();
+        stackChar = stackCharStore.data();
+
+        stackBuf.resize(64);
+        stackSize = 0;
+    }
+
+    // View of an image written by WriteImage, typically MappedFile::data().
+    // The tables are used in place, so 'image' must outlive this object;
+    // loading only checks them. Throws range_error on anything that is not
+    // a consistent PDA image of this version.
+    CompiledPDA(const void* image, size_t size) {
+        const ImageHeader* h = ReadImageHeader(image, size, IMAGE_PDA, 5);
+        if (!h) throw range_error("Not a PDA image of this version");
+
+        for (int i = 0; i < 7; i++) {
+            if (h->params[i] < 0 || h->params[i] > INT32_MAX) throw range_error("PDA image header out of range");
+        }
+        nStates = h->params[0];
+        nInputs = h->params[1];
+        nStack = h->params[2];
+        start = h->params[3];
+        epsilon = h->params[4];
+        emptyTop = h->params[5];
+        bottom = h->params[6];
+        if (nStates < 1 || nInputs < 1 || nInputs > 257 || nStack < 2 || nStack > 257 ||
+            start >= nStates || epsilon != nInputs - 1 || emptyTop != nStack - 1 || bottom >= emptyTop) {
+            throw range_error("PDA image header out of range");
+        }
+
+        size_t types, inputs, stackChars;
+        moves = ImageSectionData<Move>(h, 0, nMoves);
+        pool = ImageSectionData<uint8_t>(h, 1, poolSize);
+        stateType = ImageSectionData<uint8_t>(h, 2, types);
+        inputIdx = ImageSectionData<int16_t>(h, 3, inputs);
+        stackChar = ImageSectionData<char>(h, 4, stackChars);
+        if (nMoves != (size_t) nStates * nInputs * nStack || types != (size_t) nStates ||
+            inputs != 256 || stackChars != (size_t) nStack) {
+            throw range_error("PDA image sections do not match its header");
+        }
+
+        // Every index the runner follows must stay inside the tables
+        for (size_t i = 0; i < nMoves; i++) {
+            const Move& m = moves[i];
+            if (m.next < -1 || m.next >= nStates ||
+                (size_t) m.popOff + m.popLen > poolSize || (size_t) m.pushOff + m.pushLen > poolSize) {
+                throw range_error("PDA image move out of range");
+            }
+        }
+        for (size_t i = 0; i < poolSize; i++) {
+            if (pool[i] >= emptyTop) throw range_error("PDA image stack symbol out of range");
+        }
+        for (size_t i = 0; i < types; i++) {
+            if (stateType[i] > TERM) throw range_error("PDA image state type out of range");
+        }
+        for (size_t i = 0; i < inputs; i++) {
+            if (inputIdx[i] < -1 || inputIdx[i] >= nInputs) throw range_error("PDA image input column out of range");
+        }
+
+        stackBuf.resize(64);
+        stackSize = 0;
+    }
+
+    // The tables may point into this object's own vectors
+    CompiledPDA(const CompiledPDA&) = delete;
+    CompiledPDA& operator=(const CompiledPDA&) = delete;
+
+    // Binary image for the CompiledPDA(image, size) constructor
+    bool WriteImage(ostream& out) const {
+        ImageWriter w(IMAGE_PDA);
+        int64_t params[] = {nStates, nInputs, nStack, start, epsilon, emptyTop, bottom};
+        for (int i = 0; i < 7; i++) w.SetParam(i, params[i]);
+        w.AddSection(moves, nMoves * sizeof(Move));
+        w.AddSection(pool, poolSize);
+        w.AddSection(stateType, nStates);
+        w.AddSection(inputIdx, 256 * sizeof(int16_t));
+        w.AddSection(stackChar, nStack);
+        return w.Write(out);
+    }
+
+    size_t TableCells() const { return nMoves; }
+
+    template<class Tracer>
+    bool Run(string_view input, Tracer& tracer) {
+        int state = start;
+        stackSize = 0;
+        stackBuf[stackSize++] = bottom;
+
+        size_t pos = 0;
+        int epsilonRun = 0;
+        while (true) {
+            if (stateType[state] == SOL && pos >= input.size()) {
+                if constexpr (Tracer::enabled) {
+                    tracer.OnEvent({TRACE_ACCEPT, pos, '\0', state, state, (int) stackSize});
+                }
+                return true;
+            }
+            if (stateType[state] == TERM) break;
+
+            int top = stackSize ? stackBuf[stackSize - 1] : emptyTop;
+            int from = state;
+
+            // Input move first, epsilon move as the fallback
+            if (pos < input.size()) {
+                int i = inputIdx[(unsigned char) input[pos]];
+                if (i >= 0 && Apply(At(state, i, top), state)) {
+                    if constexpr (Tracer::enabled) {
+                        tracer.OnEvent({TRACE_STEP, pos, input[pos], from, state, (int) stackSize});
+                    }
+                    pos++;
+                    epsilonRun = 0;
+                    continue;
+                }
+            }
+            if (epsilonRun++ < PDA::MAX_EPSILON_RUN && Apply(At(state, epsilon, top), state)) {
+                if constexpr (Tracer::enabled) {
+                    tracer.OnEvent({TRACE_EPSILON, pos, PDA::EPSILON, from, state, (int) stackSize});
+                }
+                continue;
+            }
+            break;
+        }
+
+        if constexpr (Tracer::enabled) {
+            tracer.OnEvent({TRACE_REJECT, pos, '\0', state, state, (int) stackSize});
+        }
+        return false;
+    }
+
+    bool Run(string_view input) {
+        NullTracer tracer;
+        return Run(input, tracer);
+    }
+};
+
+// Nondeterministic PDA: any number of moves per (state, input, stack top)
+// and all of them are followed. Configurations advance breadth-first, one
+// input position at a time, over a graph-structured stack (GSS) as in GLR
+// parsing. A stack is any path from a node down to the root, and branches
+// pushing the same symbols at the same position share nodes whose parent
+// lists hold the union of the stacks underneath, so nothing is ever copied.
+// Each position has a bounded number of nodes and (state, node)
+// configurations, which keeps ambiguous inputs polynomial.
+class NondeterministicPDA {
+    struct Move {
+        int next;
+        string pops;   // Same conventions as TransitionEntry
+        string pushs;
+    };
+
+    struct NState {
+        StateType type;
+        // Move ids per input symbol and stack top
+        unordered_map<char, unordered_map<char, vector<int>>> transitions;
+    };
+
+    struct GSSNode {
+        char symbol;           // '\0' for the root, the empty stack
+        vector<int> parents;   // Nodes below, one per merged stack
+    };
+
+    constexpr static char STACK_BOTTOM = 'Z';
+    constexpr static char EPSILON = 'E';
+    constexpr static int ROOT = 0;
+
+    map<int, NState> states;
+    vector<Move> moves;
+    int startState;
+
+    vector<GSSNode> gss;
+    vector<pair<int, int>> configs;            // (state, top node) at the current position
+    unordered_set<uint64_t> seen;              // Configurations already in 'configs'
+    unordered_map<uint64_t, int> topNodes;     // (state, symbol) -> top node pushed here
+    unordered_map<uint64_t, int> innerNodes;   // (move, depth) -> lower node pushed here
+    bool relinked;                             // A node pushed here gained a parent
+    vector<int> bases;                         // Scratch for Apply
+    size_t peakConfigs;
+
+    static uint64_t Key(int a, int b) {
+        return ((uint64_t) (uint32_t) a << 32) | (uint32_t) b;
+    }
+
+    void BeginPosition() {
+        configs.clear();
+        seen.clear();
+        topNodes.clear();
+        innerNodes.clear();
+    }
+
+    void AddConfig(int state, int node) {
+        if (seen.insert(Key(state, node)).second) {
+            configs.push_back({state, node});
+        }
+    }
+
+    // Node for 'key' pushed at this position, with 'parent' merged into its
+    // parents. An existing node gaining a parent changes the stacks of
+    // configurations already expanded, which 'relinked' reports.
+    int PushNode(unordered_map<uint64_t, int>& nodes, uint64_t key, char symbol, int parent) {
+        auto it = nodes.find(key);
+        if (it == nodes.end()) {
+            gss.push_back({symbol, {parent}});
+            nodes.insert({key, (int) gss.size() - 1});
+            return gss.size() - 1;
+        }
+        vector<int>& parents = gss[it->second].parents;
+        if (find(parents.begin(), parents.end(), parent) == parents.end()) {
+            parents.push_back(parent);
+            relinked = true;
+        }
+        return it->second;
+    }
+
+    // Every node left after popping 'pops' (forward) off any stack at 'node'
+    void Pop(int node, const string& pops, size_t k, vector<int>& bases) {
+        if (k == pops.size()) {
+            if (find(bases.begin(), bases.end(), node) == bases.end()) bases.push_back(node);
+            return;
+        }
+        if (gss[node].symbol != pops[k]) return;
+        for (int parent : gss[node].parents) {
+            Pop(parent, pops, k + 1, bases);
+        }
+    }
+
+    // Take move 'id' from configuration (state, node) into the current position
+    void Apply(int id, int node) {
+        const Move& m = moves[id];
+        bases.clear();
+        Pop(node, m.pops, 0, bases);
+
+        for (int base : bases) {
+            if (m.pushs.empty()) {
+                AddConfig(m.next, base);
+                continue;
+            }
+            // Push backward: the last char goes lowest. Nodes below the top
+            // are shared per (move, depth), the top per (state, symbol).
+            int below = base;
+            for (int d = m.pushs.size() - 1; d > 0; d--) {
+                below = PushNode(innerNodes, Key(id, d), m.pushs[d], below);
+            }
+            int top = PushNode(topNodes, Key(m.next, (unsigned char) m.pushs[0]), m.pushs[0], below);
+            AddConfig(m.next, top);
+        }
+    }
+
+    // Moves out of 'state' on 'symbol' with 'top' on the stack, or nullptr
+    const vector<int>* Moves(int state, char symbol, char top) const {
+        auto st = states.find(state);
+        if (st == states.end() || st->second.type == TERM) return nullptr;
+        auto inputIt = st->second.transitions.find(symbol);
+        if (inputIt == st->second.transitions.end()) return nullptr;
+        auto stackIt = inputIt->second.find(top);
+        if (stackIt == inputIt->second.end()) return nullptr;
+        return &stackIt->second;
+    }
+
+    // Epsilon moves until no new configuration or stack appears
+    void Closure() {
+        do {
+            relinked = false;
+            for (size_t i = 0; i < configs.size(); i++) {
+                auto [state, node] = configs[i];
+                const vector<int>* ids = Moves(state, EPSILON, gss[node].symbol);
+                if (!ids) continue;
+                for (int id : *ids) Apply(id, node);
+            }
+        } while (relinked);
+    }
+
+public:
+    NondeterministicPDA(int start = 0) : startState(start), relinked(false), peakConfigs(0) {}
+
+    // Same machine, its single move per key becomes a one element choice
+    NondeterministicPDA(const PDA& pda) : NondeterministicPDA() {
+        for (auto& p : pda.states) {
+            AddState(p.first, p.second.type);
+            for (auto& in : p.second.transitions) {
+                for (auto& st : in.second) {
+                    const TransitionEntry& e = st.second;
+                    AddTransition(p.first, in.first, st.first, e.nextStateIdx, e.pops, e.pushs);
+                }
+            }
+        }
+    }
+
+    void AddState(int id, StateType type) {
+        states[id].type = type;
+    }
+
+    // input EPSILON for an epsilon move, top '\0' for an empty stack
+    void AddTransition(int from, char input, char top, int next, const string& pops, const string& pushs) {
+        states[from].transitions[input][top].push_back(moves.size());
+        moves.push_back({next, pops, pushs});
+    }
+
+    bool Run(string_view input) {
+        gss.clear();
+        gss.push_back({'\0', {}});
+        gss.push_back({STACK_BOTTOM, {ROOT}});
+        peakConfigs = 0;
+
+        BeginPosition();
+        AddConfig(startState, 1);
+        Closure();
+
+        vector<pair<int, int>> current;
+        for (char c : input) {
+            peakConfigs = max(peakConfigs, configs.size());
+            current.swap(configs);
+            BeginPosition();
+            // EPSILON is reserved, an input char equal to it matches nothing
+            if (c != EPSILON) {
+                for (auto [state, node] : current) {
+                    const vector<int>* ids = Moves(state, c, gss[node].symbol);
+                    if (!ids) continue;
+                    for (int id : *ids) Apply(id, node);
+                }
+            }
+            if (configs.empty()) return false;
+            Closure();
+        }
+        peakConfigs = max(peakConfigs, configs.size());
+
+        for (auto [state, node] : configs) {
+            if (states[state].type == SOL) return true;
+        }
+        return false;
+    }
+
+    // Size of the last run: GSS nodes and most configurations at one position
+    size_t GSSNodes() const { return gss.size(); }
+    size_t PeakConfigs() const { return peakConfigs; }
+};
+
+// L = { w w^R | w in {a,b}* }: push the first half, guess the middle with an
+// epsilon move, then pop the mirrored second half
+NondeterministicPDA EvenPalindromePDA() {
+    NondeterministicPDA npda;
+    npda.AddState(0, INIT);
+    npda.AddState(1, BRANCH);
+    npda.AddState(2, SOL);
+    for (char c : string("ab")) {
+        for (char top : string("abZ")) {
+            npda.AddTransition(0, c, top, 0, "", string(1, c));
+        }
+        npda.AddTransition(1, c, c, 1, string(1, c), "");
+    }
+    for (char top : string("abZ")) {
+        npda.AddTransition(0, 'E', top, 1, "", "");
+    }
+    npda.AddTransition(1, 'E', 'Z', 2, "", "");
+    return npda;
+}
+
+// a^n b^n for growing n: time per char should stay flat for both runners
+void RunBenchmarks() {
+    PDA pda;
+    CompiledPDA compiled(pda);
+
+    cout << "a^n b^n benchmark\n";
+    cout << "=================\n";
+    for (int n = 1000; n <= 10000000; n *= 10) {
+        string input(n, 'a');
+        input.append(n, 'b');
+
+        auto t0 = chrono::steady_clock::now();
+        bool a = pda.ProcessString(input);
+        auto t1 = chrono::steady_clock::now();
+        bool b = compiled.Run(input);
+        auto t2 = chrono::steady_clock::now();
+
+        double ms1 = chrono::duration<double, milli>(t1 - t0).count();
+        double ms2 = chrono::duration<double, milli>(t2 - t1).count();
+        cout << "n = " << n << " : PDA " << ms1 << " ms (" << ms1 * 1e6 / input.size() << " ns/char)"
+             << " | compiled " << ms2 << " ms (" << ms2 * 1e6 / input.size() << " ns/char)"
+             << ((a && b) ? "" : " NOT ACCEPTED") << "\n";
+    }
+
+    // a^2n is the worst case for palindromes: every position is a possible
+    // middle, so the live configurations grow with n and the total work
+    // with n^2. Doubling n should roughly quadruple the time.
+    NondeterministicPDA palindromes = EvenPalindromePDA();
+    cout << "\nEven palindrome (GSS) benchmark\n";
+    cout << "===============================\n";
+    for (int n = 500; n <= 4000; n *= 2) {
+        string input(2 * n, 'a');
+
+        auto t0 = chrono::steady_clock::now();
+        bool a = palindromes.Run(input);
+        auto t1 = chrono::steady_clock::now();
+
+        cout << "a^" << 2 * n << " : " << chrono::duration<double, milli>(t1 - t0).count() << " ms, "
+             << palindromes.GSSNodes() << " GSS nodes, peak " << palindromes.PeakConfigs()
+             << " configurations" << (a ? "" : " NOT ACCEPTED") << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        RunBenchmarks();
+        return 0;
+    }
+    
+    // Text form of the built-in machine, a starting point for new ones
+    if (argc == 3 && string(argv[1]) == "--dump") {
+        ofstream out(argv[2]);
+        PDA().SaveText(out);
+        return out ? 0 : 1;
+    }
+    
+    // Text definition -> binary image for deployment
+    if (argc == 4 && string(argv[1]) == "--compile") {
+        ifstream in(argv[2]);
+        PDA pda;
+        string error;
+        if (!in) {
+            cerr << argv[2] << ": cannot open" << endl;
+            return 1;
+        }
+        if (!pda.LoadText(in, &error)) {
+            cerr << argv[2] << ": " << error << endl;
+            return 1;
+        }
+        try {
+            ofstream out(argv[3], ios::binary);
+            if (!CompiledPDA(pda).WriteImage(out)) {
+                cerr << "Cannot write " << argv[3] << endl;
+                return 1;
+            }
+        }
+        catch (const range_error& e) {
+            cerr << argv[2] << ": " << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    
+    // Map an image and run the remaining arguments through it
+    if (argc >= 3 && string(argv[1]) == "--run") {
+        auto t0 = chrono::steady_clock::now();
+        MappedFile file;
+        if (!file.Open(argv[2])) {
+            cerr << "Cannot map " << argv[2] << endl;
+            return 1;
+        }
+        try {
+            CompiledPDA compiled(file.data(), file.size());
+            auto t1 = chrono::steady_clock::now();
+            cout << "Loaded " << argv[2] << " (" << file.size() << " bytes) in "
+                 << chrono::duration<double, micro>(t1 - t0).count() << " us\n";
+            for (int i = 3; i < argc; i++) {
+                cout << "\"" << argv[i] << "\" -> " << (compiled.Run(argv[i]) ? "ACCEPTED" : "REJECTED") << endl;
+            }
+        }
+        catch (const range_error& e) {
+            cerr << argv[2] << ": " << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    
     PDA pda;
     
     cout << "PDA for L = {a^n b^n | n >= 0}\n";
@@ -291,9 +1033,40 @@ int main() {
     cout << "\n\nTesting PDA:\n";
     cout << "============\n";
     
+    CoutTracer tracer;
     for (const string& str : testStrings) {
-        pda.ProcessString(str);
-        cout << endl;
+        cout << "\nProcessing string: \"" << str << "\"\n";
+        pda.ProcessString(str, tracer);
+    }
+    
+    // Chunked input through the streaming interface
+    cout << "\nStreaming in chunks of 2:\n";
+    cout << "=========================\n";
+    pda.Reset();
+    for (const string& str : testStrings) {
+        for (size_t i = 0; i < str.size(); i += 2) {
+            pda.Feed(str.data() + i, min((size_t) 2, str.size() - i));
+        }
+        cout << "\"" << str << "\" -> " << (pda.Finish() ? "ACCEPTED" : "REJECTED") << endl;
+    }
+    
+    // Same machine compiled to the dense move table
+    CompiledPDA compiled(pda);
+    cout << "\nCompiled (" << compiled.TableCells() << " table cells):\n";
+    cout << "==============================\n";
+    for (const string& str : testStrings) {
+        cout << "\"" << str << "\" -> " << (compiled.Run(str) ? "ACCEPTED" : "REJECTED") << endl;
+    }
+    
+    // Needs a guess at the middle, out of reach of the deterministic runners
+    NondeterministicPDA palindromes = EvenPalindromePDA();
+    cout << "\nNondeterministic PDA for L = {w w^R | w in {a,b}*}:\n";
+    cout << "===================================================\n";
+    vector<string> palindromeStrings = {"", "aa", "abba", "abab", "aba", "babbab", "aabbaa", "aabbab"};
+    for (const string& str : palindromeStrings) {
+        bool accepted = palindromes.Run(str);
+        cout << "\"" << str << "\" -> " << (accepted ? "ACCEPTED" : "REJECTED")
+             << " (" << palindromes.GSSNodes() << " GSS nodes)" << endl;
     }
     
     return 0;
@@ -1,9 +1,20 @@
 #include<iostream>
+#include<fstream>
 #include<vector>
 #include<unordered_map>
 #include<unordered_set>
 #include<string>
+#include<string_view>
 #include<stack>
+#include<array>
+#include<map>
+#include<queue>
+#include<algorithm>
+#include<chrono>
+#include<random>
+#include "dense_dfa.h"
+#include "alloc_counter.h"
+#include "tracer.h"
 
 using namespace std;
 
@@ -11,11 +22,20 @@ constexpr char EPSILON = 'E';
 
 enum StateType { INIT, BRANCH, SOL, TERM };
 
+// How NFA::Run matches its input
+enum RunMode {
+    SIMULATE,       // Walk the epsilon-NFA state sets (traces every step)
+    COMPILED_DFA,   // Single table lookup per byte on the subset-constructed DFA
+    LAZY_DFA,       // DFA states built on demand into a bounded cache
+    BIT_PARALLEL    // Glushkov position masks, a few word ops per byte
+};
+
 typedef struct State {
     string _data;
     StateType _t;
+    int _pattern;   // Index of the RE this state accepts, -1 if not accepting
     
-    State(string data = "", StateType type = BRANCH) : _data(data), _t(type) {}
+    State(string data = "", StateType type = BRANCH) : _data(data), _t(type), _pattern(-1) {}
 } State;
 
 // NFA Transition: Multiple next states possible for same input
@@ -33,6 +53,73 @@ private:
     vector<State> states;
     vector<TransitionMap> transitions;
     int stateCounter;
+    int startState;
+    RunMode mode;
+    
+    // Compiled DFA: dfaTransitions[dfaState][byte] -> next dfaState
+    // The subset construction and the lazy cache keep the dead state (loops
+    // to itself on every byte) at 0; minimization renumbers the compiled DFA
+    constexpr static int DFA_DEAD = 0;
+    vector<array<int, 256>> dfaTransitions;
+    vector<bool> dfaAccepting;
+    vector<vector<int>> dfaMatches;   // Pattern IDs accepted by each DFA state
+    int dfaStart;
+    int dfaSubsetStates;
+    
+    // Lazy DFA cache: same layout as the compiled DFA but rows are filled the
+    // first time the input takes them. LAZY_UNKNOWN marks an untaken edge.
+    // Once the estimated size passes lazyMemoryLimit the cache is flushed.
+    constexpr static int LAZY_UNKNOWN = -1;
+    constexpr static int LAZY_START = 1;
+    vector<array<int, 256>> lazyTransitions;
+    vector<bool> lazyAccepting;
+    vector<vector<int>> lazyMatches;
+    vector<vector<int>> lazySets;
+    map<vector<int>, int> lazyIds;
+    size_t lazyMemoryLimit;
+    size_t lazyMemoryUsed;
+    int lazyFlushes;
+    
+    // Read-only CSR copy of the transitions, built by Finalize() once the NFA
+    // is complete. Symbol edges of state s are edgeSymbol/edgeTarget in
+    // [edgeStart[s], edgeStart[s+1]), epsilon edges are epsTarget in
+    // [epsStart[s], epsStart[s+1]). The map form is kept for printing only.
+    vector<int> edgeStart;
+    vector<char> edgeSymbol;
+    vector<int> edgeTarget;
+    vector<int> epsStart;
+    vector<int> epsTarget;
+    
+    // Membership marks for the state lists used during simulation: a state
+    // is in the current list when stateMark[s] == markGen
+    vector<unsigned> stateMark;
+    unsigned markGen;
+    
+    // Streaming state between Feed calls, which field is live depends on
+    // the mode. The lazy cache may be flushed between calls, so the lazy
+    // mode also keeps its state set and re-interns it when lazyEpoch moved.
+    int streamState;
+    vector<int> streamSet;
+    vector<int> streamNext;
+    uint64_t streamReach[4];
+    uint64_t streamActive[4];
+    bool streamStarted;     // Any byte fed since Reset
+    bool streamDead;        // No state left, the input can no longer match
+    int streamEpoch;
+    int lazyEpoch;          // Bumped on every lazy cache flush
+    
+    // Glushkov position automaton for BIT_PARALLEL mode. Every character of
+    // the RE is one position (bit); a mask holds glushkovWords 64-bit words.
+    // glushkovFollow[(chunk * 256 + byteValue) * W] is the union of follow
+    // sets of the 8 positions of that chunk, so a step is W*8 table loads.
+    // glushkovWords is 0 when the RE has more than MAX_GLUSHKOV_POSITIONS.
+    constexpr static int MAX_GLUSHKOV_POSITIONS = 256;
+    int glushkovWords;
+    bool glushkovNullable;
+    vector<uint64_t> glushkovFirst;
+    vector<uint64_t> glushkovLast;
+    vector<uint64_t> glushkovByteMask;
+    vector<uint64_t> glushkovFollow;
     
     int CreateState(string data = "", StateType type = BRANCH) {
         states.push_back(State(data, type));
@@ -154,7 +241,7 @@ private:
     }
     
     // Add explicit concatenation operator
-    string AddConcatOperator(string re) {
+    string AddConcatOperator(const string& re) {
         string result = "";
         
         for (int i = 0; i < re.size(); i++) {
@@ -175,7 +262,7 @@ private:
     }
     
     // Convert infix to postfix
-    string InfixToPostfix(string re) {
+    string InfixToPostfix(const string& re) {
         stack<char> ops;
         string postfix = "";
         
@@ -211,16 +298,279 @@ private:
         return postfix;
     }
 
-public:
-    NFA() : stateCounter(0) {}
+    // Flatten the transition maps into the CSR arrays
+    void Finalize() {
+        int n = states.size();
+        edgeStart.assign(n + 1, 0);
+        epsStart.assign(n + 1, 0);
+        edgeSymbol.clear();
+        edgeTarget.clear();
+        epsTarget.clear();
+        
+        for (int s = 0; s < n; s++) {
+            for (auto& p : transitions[s]) {
+                for (int next : p.second) {
+                    if (p.first == EPSILON) {
+                        epsTarget.push_back(next);
+                    }
+                    else {
+                        edgeSymbol.push_back(p.first);
+                        edgeTarget.push_back(next);
+                    }
+                }
+            }
+            edgeStart[s + 1] = edgeTarget.size();
+            epsStart[s + 1] = epsTarget.size();
+        }
+        
+        stateMark.assign(n, 0);
+        markGen = 0;
+    }
+    
+    // Start a new (empty) marked state list
+    void NextMark() {
+        if (++markGen == 0) {
+            fill(stateMark.begin(), stateMark.end(), 0);
+            markGen = 1;
+        }
+    }
+    
+    void AddState(int s, vector<int>& list) {
+        if (stateMark[s] != markGen) {
+            stateMark[s] = markGen;
+            list.push_back(s);
+        }
+    }
+    
+    // Epsilon closure in place: the list doubles as the work queue. Traces
+    // every epsilon edge that brings in a new state.
+    template<class Tracer>
+    void CloseOver(vector<int>& list, Tracer& tracer, size_t pos) {
+        for (size_t i = 0; i < list.size(); i++) {
+            int s = list[i];
+            for (int e = epsStart[s]; e < epsStart[s + 1]; e++) {
+                if constexpr (Tracer::enabled) {
+                    if (stateMark[epsTarget[e]] != markGen) {
+                        tracer.OnEvent({TRACE_EPSILON, pos, EPSILON, s, epsTarget[e], -1});
+                    }
+                }
+                AddState(epsTarget[e], list);
+            }
+        }
+    }
+    
+    void CloseOver(vector<int>& list) {
+        NullTracer tracer;
+        CloseOver(list, tracer, 0);
+    }
+    
+    // next = epsilon closure of the moves of 'curr' on 'c'
+    template<class Tracer>
+    void Step(const vector<int>& curr, char c, vector<int>& next, Tracer& tracer, size_t pos) {
+        next.clear();
+        NextMark();
+        for (int s : curr) {
+            for (int e = edgeStart[s]; e < edgeStart[s + 1]; e++) {
+                if (edgeSymbol[e] == c) {
+                    if constexpr (Tracer::enabled) {
+                        tracer.OnEvent({TRACE_STEP, pos, c, s, edgeTarget[e], -1});
+                    }
+                    AddState(edgeTarget[e], next);
+                }
+            }
+        }
+        CloseOver(next, tracer, pos);
+    }
+    
+    void Step(const vector<int>& curr, char c, vector<int>& next) {
+        NullTracer tracer;
+        Step(curr, c, next, tracer, 0);
+    }
+    
+    // Epsilon closure as a sorted vector, used as the key of a DFA state
+    vector<int> ClosureKey(const unordered_set<int>& stateSet) {
+        vector<int> key;
+        NextMark();
+        for (int s : stateSet) AddState(s, key);
+        CloseOver(key);
+        sort(key.begin(), key.end());
+        return key;
+    }
+
+    struct GlushkovFragment {
+        bool nullable;
+        vector<uint64_t> first;
+        vector<uint64_t> last;
+    };
+    
+    // Glushkov construction over the postfix RE: nullable / first / last per
+    // subexpression and the follow set of every position
+    void BuildGlushkov(const string& postfix) {
+        int nPositions = 0;
+        for (char c : postfix) {
+            if (!IsOperator(c) && c != EPSILON) nPositions++;
+        }
+        
+        glushkovWords = 0;
+        if (postfix.empty() || nPositions > MAX_GLUSHKOV_POSITIONS) return;
+        
+        int W = (nPositions <= 64) ? 1 : (nPositions <= 128) ? 2 : 4;
+        vector<vector<uint64_t>> follow(nPositions, vector<uint64_t>(W, 0));
+        glushkovByteMask.assign(256 * W, 0);
+        
+        auto AddFollow = [&](const vector<uint64_t>& from, const vector<uint64_t>& to) {
+            for (int p = 0; p < nPositions; p++) {
+                if (from[p / 64] >> (p % 64) & 1) {
+                    for (int w = 0; w < W; w++) follow[p][w] |= to[w];
+                }
+            }
+        };
+        
+        stack<GlushkovFragment> fragStack;
+        int pos = 0;
+        
+        for (char c : postfix) {
+            if (c == '.' || c == '|') {
+                GlushkovFragment f2 = fragStack.top(); fragStack.pop();
+                GlushkovFragment f1 = fragStack.top(); fragStack.pop();
+                GlushkovFragment f = f1;
+                
+                if (c == '.') {
+                    AddFollow(f1.last, f2.first);
+                    f.nullable = f1.nullable && f2.nullable;
+                    f.last = f2.last;
+                    for (int w = 0; w < W; w++) {
+                        if (f1.nullable) f.first[w] |= f2.first[w];
+                        if (f2.nullable) f.last[w] |= f1.last[w];
+                    }
+                }
+                else {
+                    f.nullable = f1.nullable || f2.nullable;
+                    for (int w = 0; w < W; w++) {
+                        f.first[w] |= f2.first[w];
+                        f.last[w] |= f2.last[w];
+                    }
+                }
+                fragStack.push(f);
+            }
+            else if (c == '*' || c == '+') {
+                GlushkovFragment f = fragStack.top(); fragStack.pop();
+                AddFollow(f.last, f.first);
+                if (c == '*') f.nullable = true;
+                fragStack.push(f);
+            }
+            else {
+                GlushkovFragment f = {c == EPSILON, vector<uint64_t>(W, 0), vector<uint64_t>(W, 0)};
+                if (c != EPSILON) {
+                    f.first[pos / 64] |= 1ULL << (pos % 64);
+                    f.last[pos / 64] |= 1ULL << (pos % 64);
+                    glushkovByteMask[(unsigned char) c * W + pos / 64] |= 1ULL << (pos % 64);
+                    pos++;
+                }
+                fragStack.push(f);
+            }
+        }
+        
+        glushkovNullable = fragStack.top().nullable;
+        glushkovFirst = fragStack.top().first;
+        glushkovLast = fragStack.top().last;
+        
+        // Byte-chunked follow tables
+        int nChunks = 8 * W;
+        glushkovFollow.assign(nChunks * 256 * W, 0);
+        for (int chunk = 0; chunk < nChunks; chunk++) {
+            for (int v = 1; v < 256; v++) {
+                uint64_t* dst = &glushkovFollow[(chunk * 256 + v) * W];
+                for (int bit = 0; bit < 8; bit++) {
+                    int p = chunk * 8 + bit;
+                    if ((v >> bit & 1) && p < nPositions) {
+                        for (int w = 0; w < W; w++) dst[w] |= follow[p][w];
+                    }
+                }
+            }
+        }
+        
+        glushkovWords = W;
+    }
+    
+    // Bit-parallel Glushkov simulation: active = reach & byteMask[c], then
+    // reach = union of follow sets of the active positions
+    template<int W>
+    bool GlushkovFeed(uint64_t* reachOut, uint64_t* activeOut, const char* data, size_t len) {
+        const uint64_t* byteMask = glushkovByteMask.data();
+        const uint64_t* followTable = glushkovFollow.data();
+        uint64_t reach[W], active[W];
+        for (int w = 0; w < W; w++) {
+            reach[w] = reachOut[w];
+            active[w] = activeOut[w];
+        }
+        
+        bool alive = true;
+        for (size_t i = 0; i < len; i++) {
+            const uint64_t* mask = byteMask + (unsigned char) data[i] * W;
+            uint64_t any = 0;
+            for (int w = 0; w < W; w++) {
+                active[w] = reach[w] & mask[w];
+                any |= active[w];
+                reach[w] = 0;
+            }
+            if (!any) {
+                alive = false;
+                break;
+            }
+            
+            for (int chunk = 0; chunk < 8 * W; chunk++) {
+                unsigned v = (active[chunk / 8] >> (8 * (chunk % 8))) & 0xFF;
+                if (!v) continue;
+                const uint64_t* f = followTable + (chunk * 256 + v) * W;
+                for (int w = 0; w < W; w++) reach[w] |= f[w];
+            }
+        }
+        
+        for (int w = 0; w < W; w++) {
+            reachOut[w] = reach[w];
+            activeOut[w] = active[w];
+        }
+        return alive;
+    }
     
-    void BuildFromRE(string re) {
+    bool GlushkovAccepts(const uint64_t* active) {
+        uint64_t accepted = 0;
+        for (int w = 0; w < glushkovWords; w++) accepted |= active[w] & glushkovLast[w];
+        return accepted != 0;
+    }
+    
+    template<int W>
+    bool RunGlushkov(string_view input) {
+        if (input.empty()) return glushkovNullable;
+        
+        uint64_t reach[W], active[W] = {};
+        for (int w = 0; w < W; w++) reach[w] = glushkovFirst[w];
+        
+        if (!GlushkovFeed<W>(reach, active, input.data(), input.size())) return false;
+        return GlushkovAccepts(active);
+    }
+    
+    // Sorted IDs of the patterns accepted by a set of NFA states
+    vector<int> PatternsOf(const vector<int>& stateSet) {
+        vector<int> ids;
+        for (int s : stateSet) {
+            if (states[s]._pattern >= 0) ids.push_back(states[s]._pattern);
+        }
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+    
+    // Thompson construction of a single RE, returns its fragment
+    // (start -1 for an empty RE) and hands back its postfix form
+    NFAFragment BuildFragment(const string& re, string& postfix) {
         // Add explicit concatenation
         string withConcat = AddConcatOperator(re);
         cout << "With concat operator: " << withConcat << endl;
         
         // Convert to postfix
-        string postfix = InfixToPostfix(withConcat);
+        postfix = InfixToPostfix(withConcat);
         cout << "Postfix: " << postfix << endl << endl;
         
         // Build NFA using stack
@@ -260,12 +610,439 @@ public:
             }
         }
         
+        return nfaStack.empty() ? NFAFragment() : nfaStack.top();
+    }
+    
+    // Rough footprint of one cached state: its row, its set stored twice
+    // (lazySets and the lazyIds key) and the map node
+    size_t LazyStateCost(const vector<int>& key) {
+        return sizeof(array<int, 256>) + 2 * key.size() * sizeof(int) + 64;
+    }
+    
+    int LazyIntern(const vector<int>& key) {
+        auto it = lazyIds.find(key);
+        if (it != lazyIds.end()) return it->second;
+        
+        int id = lazySets.size();
+        lazyIds[key] = id;
+        lazySets.push_back(key);
+        lazyTransitions.push_back(array<int, 256>());
+        lazyTransitions[id].fill(LAZY_UNKNOWN);
+        
+        bool accepting = false;
+        for (int s : key) {
+            if (states[s]._t == SOL) accepting = true;
+        }
+        lazyAccepting.push_back(accepting);
+        lazyMatches.push_back(PatternsOf(key));
+        lazyMemoryUsed += LazyStateCost(key);
+        
+        return id;
+    }
+    
+    // Drop every cached state, keeping only the dead and start states
+    void LazyFlush() {
+        lazyTransitions.clear();
+        lazyAccepting.clear();
+        lazyMatches.clear();
+        lazySets.clear();
+        lazyIds.clear();
+        lazyMemoryUsed = 0;
+        lazyEpoch++;
+        
+        LazyIntern(vector<int>());
+        lazyTransitions[DFA_DEAD].fill(DFA_DEAD);
+        LazyIntern(ClosureKey({startState}));
+    }
+    
+    // Slow path of the lazy DFA: build the edge from cached state 'curr' on
+    // byte 'c'. May flush the cache, so 'curr' is re-interned and updated.
+    int LazyStep(int& curr, unsigned char c) {
+        vector<int> key;
+        Step(lazySets[curr], (char) c, key);
+        sort(key.begin(), key.end());
+        
+        if (lazyIds.find(key) == lazyIds.end() &&
+            lazyMemoryUsed + LazyStateCost(key) > lazyMemoryLimit) {
+            // Keep the state we are standing on alive across the flush
+            vector<int> currKey = lazySets[curr];
+            LazyFlush();
+            lazyFlushes++;
+            curr = LazyIntern(currKey);
+        }
+        
+        int next = LazyIntern(key);
+        lazyTransitions[curr][c] = next;
+        return next;
+    }
+
+public:
+    NFA() : stateCounter(0), startState(0), mode(SIMULATE), dfaStart(DFA_DEAD), dfaSubsetStates(0),
+            lazyMemoryLimit(1 << 20), lazyMemoryUsed(0), lazyFlushes(0), markGen(0),
+            streamState(0), streamStarted(false), streamDead(false), streamEpoch(0), lazyEpoch(0),
+            glushkovWords(0), glushkovNullable(false) {}
+    
+    void BuildFromRE(string_view re) {
+        BuildFromREs({string(re)});
+    }
+    
+    // Union of several REs under one start state. The accepting state of
+    // the i-th RE is tagged with pattern ID i, see RunMulti.
+    void BuildFromREs(const vector<string>& res) {
+        // Start from an empty machine, Finalize and BuildGlushkov redo the
+        // CSR and Glushkov tables below
+        states.clear();
+        transitions.clear();
+        stateCounter = 0;
+        startState = 0;
+        
+        vector<NFAFragment> fragments;
+        vector<int> patternIds;
+        string combinedPostfix = "";
+        
+        for (int i = 0; i < res.size(); i++) {
+            string postfix;
+            NFAFragment frag = BuildFragment(res[i], postfix);
+            if (frag.startState == -1) continue;
+            
+            fragments.push_back(frag);
+            patternIds.push_back(i);
+            combinedPostfix += postfix;
+            if (fragments.size() > 1) combinedPostfix += '|';
+        }
+        
         // Final NFA
-        if (!nfaStack.empty()) {
-            NFAFragment finalNFA = nfaStack.top();
-            states[0]._t = INIT;
-            states[finalNFA.endState]._t = SOL;
+        if (fragments.size() == 1) {
+            startState = fragments[0].startState;
+        }
+        else if (fragments.size() > 1) {
+            startState = CreateState("|", BRANCH);
+            for (NFAFragment& frag : fragments) {
+                AddTransition(startState, EPSILON, frag.startState);
+            }
+        }
+        else {
+            // No RE had any content: a lone start state that accepts nothing
+            startState = CreateState("", INIT);
+        }
+        
+        if (!fragments.empty()) {
+            states[startState]._t = INIT;
+            for (int i = 0; i < fragments.size(); i++) {
+                states[fragments[i].endState]._t = SOL;
+                states[fragments[i].endState]._pattern = patternIds[i];
+            }
+        }
+        
+        Finalize();
+        BuildGlushkov(combinedPostfix);
+        
+        // Any previously compiled DFA belongs to the old NFA, recompile it
+        // when COMPILED_DFA is running on it
+        dfaTransitions.clear();
+        dfaAccepting.clear();
+        dfaMatches.clear();
+        if (mode == COMPILED_DFA) {
+            CompileToDFA();
+        }
+        LazyFlush();
+        lazyFlushes = 0;
+        Reset();
+    }
+    
+    // Powerset construction: every reachable epsilon-closed set of NFA states
+    // becomes one DFA state with a dense 256 entry transition row
+    void CompileToDFA() {
+        dfaTransitions.clear();
+        dfaAccepting.clear();
+        dfaMatches.clear();
+        
+        map<vector<int>, int> dfaIds;
+        vector<vector<int>> dfaSets;
+        
+        // Dead state for the empty set
+        dfaIds[vector<int>()] = DFA_DEAD;
+        dfaSets.push_back(vector<int>());
+        dfaTransitions.push_back(array<int, 256>());
+        dfaTransitions[DFA_DEAD].fill(DFA_DEAD);
+        dfaAccepting.push_back(false);
+        dfaMatches.push_back(vector<int>());
+        
+        queue<int> pending;
+        auto GetId = [&](const vector<int>& key) {
+            auto it = dfaIds.find(key);
+            if (it != dfaIds.end()) return it->second;
+            
+            int id = dfaSets.size();
+            dfaIds[key] = id;
+            dfaSets.push_back(key);
+            dfaTransitions.push_back(array<int, 256>());
+            dfaTransitions[id].fill(DFA_DEAD);
+            
+            bool accepting = false;
+            for (int s : key) {
+                if (states[s]._t == SOL) accepting = true;
+            }
+            dfaAccepting.push_back(accepting);
+            dfaMatches.push_back(PatternsOf(key));
+            
+            pending.push(id);
+            return id;
+        };
+        
+        dfaStart = GetId(ClosureKey({startState}));
+        
+        while (!pending.empty()) {
+            int curr = pending.front();
+            pending.pop();
+            
+            // Group the moves of all NFA states in the set by input symbol
+            unordered_map<char, unordered_set<int>> moves;
+            for (int s : dfaSets[curr]) {
+                for (int e = edgeStart[s]; e < edgeStart[s + 1]; e++) {
+                    moves[edgeSymbol[e]].insert(edgeTarget[e]);
+                }
+            }
+            
+            // Bytes without a move stay on the dead state
+            for (auto& p : moves) {
+                int next = GetId(ClosureKey(p.second));
+                dfaTransitions[curr][(unsigned char) p.first] = next;
+            }
+        }
+        
+        // Collapse equivalent subset states so the table stays small
+        dfaSubsetStates = dfaTransitions.size();
+        DenseDFA subset(dfaSubsetStates, 256, dfaStart);
+        for (int i = 0; i < dfaSubsetStates; i++) {
+            subset.accepting[i] = dfaAccepting[i];
+            for (int b = 0; b < 256; b++) {
+                subset.table[i * 256 + b] = dfaTransitions[i][b];
+            }
+        }
+        
+        // States may only merge when they accept the same pattern IDs
+        map<vector<int>, int> matchClassIds;
+        vector<int> matchClass(dfaSubsetStates);
+        for (int i = 0; i < dfaSubsetStates; i++) {
+            auto it = matchClassIds.insert({dfaMatches[i], matchClassIds.size()}).first;
+            matchClass[i] = it->second;
+        }
+        
+        MinimizedDFA minimal = MinimizeDFA(subset, matchClass);
+        vector<vector<int>> minimalMatches(minimal.dfa.nStates);
+        for (int i = 0; i < dfaSubsetStates; i++) {
+            if (minimal.stateMap[i] != -1) minimalMatches[minimal.stateMap[i]] = dfaMatches[i];
+        }
+        dfaMatches = minimalMatches;
+        
+        dfaTransitions.assign(minimal.dfa.nStates, array<int, 256>());
+        dfaAccepting = minimal.dfa.accepting;
+        dfaStart = minimal.dfa.start;
+        for (int i = 0; i < minimal.dfa.nStates; i++) {
+            for (int b = 0; b < 256; b++) {
+                dfaTransitions[i][b] = minimal.dfa.Next(i, b);
+            }
+        }
+    }
+    
+    // False, with the mode unchanged, when no NFA has been built yet
+    bool SetMode(RunMode m) {
+        if (states.empty()) return false;
+        mode = m;
+        if (mode == COMPILED_DFA && dfaTransitions.empty()) {
+            CompileToDFA();
+        }
+        Reset();
+        return true;
+    }
+    
+    // Streaming interface: Feed may be called any number of times with
+    // consecutive chunks of one input, Finish reports whether the whole
+    // input matched and resets for the next one. Uses the current mode
+    // (quietly, SIMULATE does not trace).
+    void Reset() {
+        streamStarted = false;
+        streamDead = false;
+        streamState = (mode == COMPILED_DFA) ? dfaStart : LAZY_START;
+        streamEpoch = lazyEpoch;
+        
+        streamSet.clear();
+        NextMark();
+        AddState(startState, streamSet);
+        CloseOver(streamSet);
+        if (mode == LAZY_DFA) streamSet = lazySets[LAZY_START];
+        
+        for (int w = 0; w < 4; w++) {
+            streamReach[w] = (w < glushkovWords) ? glushkovFirst[w] : 0;
+            streamActive[w] = 0;
+        }
+    }
+    
+    void Feed(const char* data, size_t len) {
+        if (len == 0 || streamDead) return;
+        streamStarted = true;
+        
+        if (mode == COMPILED_DFA) {
+            int stateNo = streamState;
+            for (size_t i = 0; i < len; i++) {
+                stateNo = dfaTransitions[stateNo][(unsigned char) data[i]];
+            }
+            streamState = stateNo;
+        }
+        else if (mode == LAZY_DFA) {
+            if (streamEpoch != lazyEpoch) streamState = LazyIntern(streamSet);
+            
+            int stateNo = streamState;
+            for (size_t i = 0; i < len; i++) {
+                int next = lazyTransitions[stateNo][(unsigned char) data[i]];
+                if (next == LAZY_UNKNOWN) {
+                    next = LazyStep(stateNo, (unsigned char) data[i]);
+                }
+                stateNo = next;
+            }
+            streamState = stateNo;
+            streamSet = lazySets[stateNo];
+            streamEpoch = lazyEpoch;
+        }
+        else if (mode == BIT_PARALLEL && glushkovWords > 0) {
+            bool alive = true;
+            switch (glushkovWords) {
+                case 1: alive = GlushkovFeed<1>(streamReach, streamActive, data, len); break;
+                case 2: alive = GlushkovFeed<2>(streamReach, streamActive, data, len); break;
+                case 4: alive = GlushkovFeed<4>(streamReach, streamActive, data, len); break;
+            }
+            streamDead = !alive;
+        }
+        else {
+            for (size_t i = 0; i < len; i++) {
+                Step(streamSet, data[i], streamNext);
+                streamSet.swap(streamNext);
+                if (streamSet.empty()) {
+                    streamDead = true;
+                    break;
+                }
+            }
+        }
+    }
+    
+    bool Finish() {
+        bool accepted = false;
+        
+        if (!streamDead) {
+            if (mode == COMPILED_DFA) {
+                accepted = dfaAccepting[streamState];
+            }
+            else if (mode == LAZY_DFA) {
+                if (streamEpoch != lazyEpoch) streamState = LazyIntern(streamSet);
+                accepted = lazyAccepting[streamState];
+            }
+            else if (mode == BIT_PARALLEL && glushkovWords > 0) {
+                accepted = streamStarted ? GlushkovAccepts(streamActive) : glushkovNullable;
+            }
+            else {
+                for (int s : streamSet) {
+                    if (states[s]._t == SOL) accepted = true;
+                }
+            }
         }
+        
+        Reset();
+        return accepted;
+    }
+    
+    int DFAStateCount() {
+        return dfaTransitions.size();
+    }
+    
+    // Compiled DFA (built on demand) with equal byte columns merged
+    ByteDFA ToByteDFA() {
+        if (dfaTransitions.empty()) {
+            CompileToDFA();
+        }
+        ByteDFA b;
+        b.dfa = DenseDFA(dfaTransitions.size(), 256, dfaStart);
+        for (int i = 0; i < b.dfa.nStates; i++) {
+            b.dfa.accepting[i] = dfaAccepting[i];
+            for (int c = 0; c < 256; c++) {
+                b.dfa.table[i * 256 + c] = dfaTransitions[i][c];
+            }
+        }
+        for (int c = 0; c < 256; c++) {
+            b.byteClass[c] = c;
+        }
+        return MergeByteClasses(b);
+    }
+    
+    // DFA size straight out of the subset construction, before minimization
+    int DFASubsetStateCount() {
+        return dfaSubsetStates;
+    }
+    
+    // Upper bound (in bytes) for the lazy DFA cache
+    void SetLazyCacheLimit(size_t bytes) {
+        lazyMemoryLimit = bytes;
+        LazyFlush();
+        lazyFlushes = 0;
+    }
+    
+    int LazyStateCount() {
+        return lazySets.size();
+    }
+    
+    int LazyFlushCount() {
+        return lazyFlushes;
+    }
+    
+    // Match through the lazy DFA, building missing edges as they are taken
+    template<class Tracer>
+    bool RunLazyDFA(string_view input, Tracer& tracer) {
+        int stateNo = LAZY_START;
+        
+        for (size_t i = 0; i < input.size(); i++) {
+            int next = lazyTransitions[stateNo][(unsigned char) input[i]];
+            if (next == LAZY_UNKNOWN) {
+                next = LazyStep(stateNo, (unsigned char) input[i]);
+            }
+            if constexpr (Tracer::enabled) {
+                tracer.OnEvent({TRACE_STEP, i, input[i], stateNo, next, -1});
+            }
+            stateNo = next;
+        }
+        
+        if constexpr (Tracer::enabled) {
+            tracer.OnEvent({lazyAccepting[stateNo] ? TRACE_ACCEPT : TRACE_REJECT, input.size(), '\0', stateNo, stateNo, -1});
+        }
+        return lazyAccepting[stateNo];
+    }
+    
+    bool RunLazyDFA(string_view input) {
+        NullTracer tracer;
+        return RunLazyDFA(input, tracer);
+    }
+    
+    // Table driven match on the compiled DFA
+    template<class Tracer>
+    bool RunDFA(string_view input, Tracer& tracer) {
+        int stateNo = dfaStart;
+        
+        for (size_t i = 0; i < input.size(); i++) {
+            int next = dfaTransitions[stateNo][(unsigned char) input[i]];
+            if constexpr (Tracer::enabled) {
+                tracer.OnEvent({TRACE_STEP, i, input[i], stateNo, next, -1});
+            }
+            stateNo = next;
+        }
+        
+        if constexpr (Tracer::enabled) {
+            tracer.OnEvent({dfaAccepting[stateNo] ? TRACE_ACCEPT : TRACE_REJECT, input.size(), '\0', stateNo, stateNo, -1});
+        }
+        return dfaAccepting[stateNo];
+    }
+    
+    bool RunDFA(string_view input) {
+        NullTracer tracer;
+        return RunDFA(input, tracer);
     }
     
     void PrintNFA() {
@@ -303,73 +1080,244 @@ public:
         cout << endl;
     }
     
-    bool Run(string input) {
-        // Start with epsilon closure of initial state
-        unordered_set<int> currentStates = {0};
-        currentStates = EpsilonClosure(currentStates);
+    // Epsilon-NFA simulation on the CSR arrays. Traces every edge taken;
+    // the end event carries an accepting NFA state, or -1 if none.
+    template<class Tracer>
+    bool Simulate(string_view input, Tracer& tracer) {
+        vector<int> currentStates, nextStates;
+        NextMark();
+        AddState(startState, currentStates);
+        CloseOver(currentStates, tracer, 0);
         
-        cout << "Processing string: \"" << input << "\"\n";
-        cout << "================================\n";
+        for (size_t i = 0; i < input.size(); i++) {
+            Step(currentStates, input[i], nextStates, tracer, i);
+            if (nextStates.empty()) {
+                if constexpr (Tracer::enabled) {
+                    tracer.OnEvent({TRACE_REJECT, i + 1, '\0', -1, -1, -1});
+                }
+                return false;
+            }
+            currentStates.swap(nextStates);
+        }
+        
+        for (int state : currentStates) {
+            if (states[state]._t == SOL) {
+                if constexpr (Tracer::enabled) {
+                    tracer.OnEvent({TRACE_ACCEPT, input.size(), '\0', state, state, -1});
+                }
+                return true;
+            }
+        }
         
-        // Print initial states
-        cout << "Initial states (with \u03B5-closure): {";  // \u03B5 => ε
-        bool first = true;
-        for (int s : currentStates) {
-            if (!first) cout << ", ";
-            cout << s;
-            first = false;
+        if constexpr (Tracer::enabled) {
+            tracer.OnEvent({TRACE_REJECT, input.size(), '\0', -1, -1, -1});
         }
-        cout << "}\n\n";
+        return false;
+    }
+    
+    bool SimulateCSR(string_view input) {
+        NullTracer tracer;
+        return Simulate(input, tracer);
+    }
+    
+    // Quiet simulation on the per-state hash maps (layout before Finalize),
+    // kept as the baseline for the layout benchmark
+    bool SimulateMaps(string_view input) {
+        unordered_set<int> currentStates = EpsilonClosure({startState});
         
-        // Process each character
         for (char c : input) {
             unordered_set<int> nextStates;
-            
-            cout << "Reading '" << c << "':\n";
-            
-            // For each current state, follow transitions on 'c'
             for (int state : currentStates) {
-                if (transitions[state].find(c) != transitions[state].end()) {
-                    for (int next : transitions[state][c]) {
-                        nextStates.insert(next);
-                    }
+                auto it = transitions[state].find(c);
+                if (it != transitions[state].end()) {
+                    nextStates.insert(it->second.begin(), it->second.end());
                 }
             }
-            
-            // Get epsilon closure of next states
             nextStates = EpsilonClosure(nextStates);
-            
-            cout << "   Next states (with \u03B5-closure): {";  // \u03B5 => ε
-            first = true;
-            for (int s : nextStates) {
-                if (!first) cout << ", ";
-                cout << s;
-                first = false;
-            }
-            cout << "}\n\n";
-            
-            if (nextStates.empty()) {
-                cout << "\u2717 String REJECTED! (No valid transitions)\n";  // \u2717 => ✗
-                return false;
-            }
-            
+            if (nextStates.empty()) return false;
             currentStates = nextStates;
         }
         
-        // Check if any current state is an accepting state
         for (int state : currentStates) {
-            if (states[state]._t == SOL) {
-                cout << "\u2713 String ACCEPTED! (Reached accepting state " << state << ")\n";  // \u2713 => ✓
-                return true;
+            if (states[state]._t == SOL) return true;
+        }
+        return false;
+    }
+    
+    // 64-bit words per Glushkov mask, 0 when BIT_PARALLEL falls back to
+    // the NFA simulation
+    int GlushkovWords() {
+        return glushkovWords;
+    }
+    
+    bool RunBitParallel(string_view input) {
+        switch (glushkovWords) {
+            case 1: return RunGlushkov<1>(input);
+            case 2: return RunGlushkov<2>(input);
+            case 4: return RunGlushkov<4>(input);
+            default: return SimulateCSR(input);
+        }
+    }
+    
+    // One pass over the input, returns the sorted IDs of every RE passed to
+    // BuildFromREs that matches it. Uses the DFA in the DFA modes and the
+    // CSR simulation otherwise.
+    vector<int> RunMulti(string_view input) {
+        if (mode == COMPILED_DFA) {
+            int stateNo = dfaStart;
+            for (char c : input) {
+                stateNo = dfaTransitions[stateNo][(unsigned char) c];
             }
+            return dfaMatches[stateNo];
+        }
+        if (mode == LAZY_DFA) {
+            int stateNo = LAZY_START;
+            for (char c : input) {
+                int next = lazyTransitions[stateNo][(unsigned char) c];
+                if (next == LAZY_UNKNOWN) {
+                    next = LazyStep(stateNo, (unsigned char) c);
+                }
+                stateNo = next;
+            }
+            return lazyMatches[stateNo];
         }
         
-        cout << "\u2717 String REJECTED! (No accepting state reached)\n";  // \u2717 => ✗
-        return false;
+        vector<int> currentStates, nextStates;
+        NextMark();
+        AddState(startState, currentStates);
+        CloseOver(currentStates);
+        
+        for (char c : input) {
+            Step(currentStates, c, nextStates);
+            if (nextStates.empty()) return vector<int>();
+            currentStates.swap(nextStates);
+        }
+        
+        return PatternsOf(currentStates);
+    }
+    
+    bool Run(const char* data, size_t len) {
+        return Run(string_view(data, len));
+    }
+    
+    bool Run(string_view input) {
+        NullTracer tracer;
+        return Run(input, tracer);
+    }
+    
+    // Run in the current mode reporting steps to 'tracer' (see tracer.h).
+    // BIT_PARALLEL only reports the final verdict.
+    template<class Tracer>
+    bool Run(string_view input, Tracer& tracer) {
+        if (mode == COMPILED_DFA) {
+            return RunDFA(input, tracer);
+        }
+        if (mode == LAZY_DFA) {
+            return RunLazyDFA(input, tracer);
+        }
+        if (mode == BIT_PARALLEL) {
+            bool accepted = RunBitParallel(input);
+            if constexpr (Tracer::enabled) {
+                tracer.OnEvent({accepted ? TRACE_ACCEPT : TRACE_REJECT, input.size(), '\0', -1, -1, -1});
+            }
+            return accepted;
+        }
+        
+        return Simulate(input, tracer);
     }
 };
 
-int main() {
+// Hash map layout vs CSR layout on (a|b)*abb over long random inputs
+void RunBenchmarks() {
+    NFA nfa;
+    nfa.BuildFromRE("(a|b)*abb");
+    
+    mt19937 rng(42);
+    cout << "\nLayout benchmark: (a|b)*abb\n";
+    cout << "===========================\n";
+    
+    for (int len : {10000, 100000, 1000000}) {
+        string input;
+        for (int i = 0; i < len - 3; i++) input += (rng() & 1) ? 'a' : 'b';
+        input += "abb";
+        
+        auto t0 = chrono::steady_clock::now();
+        bool mapResult = nfa.SimulateMaps(input);
+        auto t1 = chrono::steady_clock::now();
+        bool csrResult = nfa.SimulateCSR(input);
+        auto t2 = chrono::steady_clock::now();
+        
+        double mapMs = chrono::duration<double, milli>(t1 - t0).count();
+        double csrMs = chrono::duration<double, milli>(t2 - t1).count();
+        
+        cout << "Length " << len << ":\n";
+        cout << "   unordered_map : " << mapMs << " ms (" << (mapResult ? "ACCEPTED" : "REJECTED") << ")\n";
+        cout << "   CSR           : " << csrMs << " ms (" << (csrResult ? "ACCEPTED" : "REJECTED") << ")\n";
+        cout << "   Speedup       : " << mapMs / csrMs << "x\n";
+    }
+}
+
+// Heap allocations per call on short records: passing a std::string by
+// value (the old signature) against the string_view API
+void RunAllocationBenchmark() {
+    NFA nfa;
+    nfa.BuildFromRE("(a|b)*abb");
+    nfa.SetMode(COMPILED_DFA);
+    
+    vector<string> records;
+    mt19937 rng(11);
+    for (int i = 0; i < 100000; i++) {
+        string record;
+        for (int j = 0; j < 40; j++) record += (rng() & 1) ? 'a' : 'b';
+        records.push_back(record);
+    }
+    
+    auto RunByValue = [&](string input) { return nfa.Run(input); };
+    
+    cout << "\nAllocation benchmark: " << records.size() << " records of 40 chars\n";
+    cout << "==============================================\n";
+    
+    int matches = 0;
+    size_t a0 = AllocationCount();
+    auto t0 = chrono::steady_clock::now();
+    for (const string& r : records) matches += RunByValue(r);
+    auto t1 = chrono::steady_clock::now();
+    size_t a1 = AllocationCount();
+    for (const string& r : records) matches += nfa.Run(r);
+    auto t2 = chrono::steady_clock::now();
+    size_t a2 = AllocationCount();
+    
+    cout << "   string by value : " << (double) (a1 - a0) / records.size() << " allocs/call, "
+         << chrono::duration<double, nano>(t1 - t0).count() / records.size() << " ns/call\n";
+    cout << "   string_view     : " << (double) (a2 - a1) / records.size() << " allocs/call, "
+         << chrono::duration<double, nano>(t2 - t1).count() / records.size() << " ns/call\n";
+    cout << "   (" << matches << " matches)\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        RunBenchmarks();
+        RunAllocationBenchmark();
+        return 0;
+    }
+    
+    // --dump <regex> <file> : compiled DFA in the text form read by dfa_codegen
+    if (argc > 3 && string(argv[1]) == "--dump") {
+        NFA nfa;
+        nfa.BuildFromRE(argv[2]);
+        ofstream out(argv[3]);
+        WriteByteDFA(out, nfa.ToByteDFA());
+        return 0;
+    }
+    
+    // --image <regex> <file> : compiled DFA as a binary image for dfa_run
+    if (argc > 3 && string(argv[1]) == "--image") {
+        NFA nfa;
+        nfa.BuildFromRE(argv[2]);
+        ofstream out(argv[3], ios::binary);
+        return WriteByteDFAImage(out, nfa.ToByteDFA()) ? 0 : 1;
+    }
+    
     // Test RE to NFA conversion
     vector<string> regularExpressions = {
         "(a|b)*abb"     // Pattern matching
@@ -389,13 +1337,103 @@ int main() {
         
         cout << "\nTesting strings:\n";
         cout << "================\n";
+        CoutTracer tracer;
         for (string str : testStrings) {
-            bool result = nfa.Run(str);
+            cout << "Processing string: \"" << str << "\"\n";
+            nfa.Run(str, tracer);
             cout << endl;
         }
         
+        // Same strings on the compiled DFA
+        nfa.SetMode(COMPILED_DFA);
+        cout << "Compiled DFA (" << nfa.DFASubsetStateCount() << " subset states, "
+             << nfa.DFAStateCount() << " after minimization):\n";
+        cout << "================\n";
+        for (string str : testStrings) {
+            cout << "   \"" << str << "\" -> " << (nfa.Run(str) ? "ACCEPTED" : "REJECTED") << "\n";
+        }
+        
         cout << "\n";
     }
     
+    // Full subset construction of this pattern has 2^9 states, the lazy DFA
+    // only builds the ones the input reaches and stays under its memory cap
+    string blowup = "(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)";
+    cout << "\n========================================\n";
+    cout << "Lazy DFA: " << blowup << "\n";
+    cout << "========================================\n\n";
+    
+    NFA lazy;
+    lazy.BuildFromRE(blowup);
+    lazy.SetMode(LAZY_DFA);
+    lazy.SetLazyCacheLimit(64 * 1024);
+    
+    vector<string> lazyStrings = {"aaaaaaaaa", "abbbbbbbb", "babababab", "bbbbbbbbbbbb"};
+    for (string str : lazyStrings) {
+        cout << "   \"" << str << "\" -> " << (lazy.Run(str) ? "ACCEPTED" : "REJECTED") << "\n";
+    }
+    cout << "Cached states: " << lazy.LazyStateCount()
+         << " | Flushes: " << lazy.LazyFlushCount() << "\n";
+    
+    // Keep only the last few step events of a run for inspection
+    RingBufferTracer ring(4);
+    lazy.Run("babababaa", ring);
+    cout << "\nLast " << ring.Events().size() << " events (" << ring.Dropped() << " dropped):\n";
+    for (const TraceEvent& e : ring.Events()) {
+        PrintTraceEvent(cout, e);
+    }
+    
+    lazy.SetMode(BIT_PARALLEL);
+    cout << "\nBit-parallel (" << lazy.GlushkovWords() << " x 64-bit mask):\n";
+    for (string str : lazyStrings) {
+        cout << "   \"" << str << "\" -> " << (lazy.Run(str) ? "ACCEPTED" : "REJECTED") << "\n";
+    }
+    
+    // Chunked input through the streaming interface in every mode
+    cout << "\nStreaming \"abababb\" in chunks of 2:\n";
+    NFA streamed;
+    streamed.BuildFromRE("(a|b)*abb");
+    string chunked = "abababb";
+    for (RunMode m : {SIMULATE, COMPILED_DFA, LAZY_DFA, BIT_PARALLEL}) {
+        streamed.SetMode(m);
+        for (size_t i = 0; i < chunked.size(); i += 2) {
+            streamed.Feed(chunked.data() + i, min((size_t) 2, chunked.size() - i));
+        }
+        cout << "   Mode " << m << " -> " << (streamed.Finish() ? "ACCEPTED" : "REJECTED") << "\n";
+    }
+
+    // An empty RE builds a machine that accepts nothing, in every mode
+    cout << "\nEmpty RE on a fresh NFA:\n";
+    for (RunMode m : {SIMULATE, COMPILED_DFA, LAZY_DFA, BIT_PARALLEL}) {
+        NFA empty;
+        empty.BuildFromRE("");
+        empty.SetMode(m);
+        bool accepted = empty.Run("") || empty.Run("ab");
+        empty.Feed("a", 1);
+        accepted = empty.Finish() || accepted;
+        cout << "   Mode " << m << " -> " << (accepted ? "ACCEPTED (wrong)" : "REJECTED") << "\n";
+    }
+
+    // Several REs compiled into one automaton, one pass per string
+    vector<string> patterns = {"(a|b)*abb", "a+", "(ab)+", "b(a|b)*"};
+    cout << "\n========================================\n";
+    cout << "Multi-pattern:";
+    for (string re : patterns) cout << " " << re;
+    cout << "\n========================================\n\n";
+    
+    NFA multi;
+    multi.BuildFromREs(patterns);
+    multi.SetMode(COMPILED_DFA);
+    
+    vector<string> multiStrings = {"abb", "aaa", "abab", "babb", "ba"};
+    for (string str : multiStrings) {
+        cout << "   \"" << str << "\" -> {";
+        vector<int> ids = multi.RunMulti(str);
+        for (int i = 0; i < ids.size(); i++) {
+            cout << (i ? ", " : "") << patterns[ids[i]];
+        }
+        cout << "}\n";
+    }
+    
     return 0;
 }
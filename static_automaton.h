@@ -0,0 +1,158 @@
+#ifndef STATIC_AUTOMATON_H
+#define STATIC_AUTOMATON_H
+
+#include<array>
+#include<cstddef>
+#include<cstdint>
+#include<string_view>
+#include<type_traits>
+
+// Automata for patterns known at build time. The transition tables are
+// std::arrays computed by constexpr builders, so they cost nothing at
+// startup, live in read-only data, and Run can itself be evaluated at
+// compile time (e.g. inside a static_assert).
+//
+// Both tables are indexed [state * 256 + byte] with the language check and
+// the absorbing TERM state folded in, like the run tables of Automaton and
+// DivisibilityAutomaton, and follow the same state numbering. Building them
+// has to fit the compiler's constexpr evaluation budget, which allows a few
+// hundred thousand cells, so these are meant for short patterns and small
+// divisors.
+
+// String literal usable as a template argument: StaticAutomaton<"ab", "bab">
+template<size_t N>
+struct FixedString {
+    char value[N];
+
+    constexpr FixedString(const char (&s)[N]) {
+        for (size_t i = 0; i < N; i++) value[i] = s[i];
+    }
+
+    constexpr size_t size() const { return N - 1; }
+    constexpr char operator[](size_t i) const { return value[i]; }
+
+    constexpr bool contains(char c) const {
+        for (size_t i = 0; i + 1 < N; i++) {
+            if (value[i] == c) return true;
+        }
+        return false;
+    }
+};
+
+// Narrowest cell type holding every state number
+template<size_t States>
+using StateCell = std::conditional_t<(States <= 256), uint8_t,
+                  std::conditional_t<(States <= 65536), uint16_t, uint32_t>>;
+
+// Compile-time Automaton(Language, Pattern): accepts inputs over Language
+// that end with Pattern. State i stands for the first i pattern chars, state
+// |Pattern| is SOL and the last state is TERM.
+template<FixedString Language, FixedString Pattern>
+class StaticAutomaton {
+public:
+    static constexpr size_t nStates = Pattern.size() + 2;
+    static constexpr int accept = Pattern.size();
+    static constexpr int trap = nStates - 1;
+
+    using Cell = StateCell<nStates>;
+
+private:
+    // KMP construction as in Automaton::buildKMP, on byte columns. Language
+    // chars outside the pattern keep the state, other bytes go to TERM.
+    static constexpr std::array<Cell, nStates * 256> Build() {
+        std::array<Cell, nStates * 256> t{};
+        constexpr size_t m = Pattern.size();
+
+        if (m > 0) {
+            t[(unsigned char) Pattern[0]] = 1;
+            int X = 0;
+            for (size_t i = 1; i <= m; i++) {
+                for (int c = 0; c < 256; c++) {
+                    t[i * 256 + c] = t[X * 256 + c];
+                }
+                if (i < m) {
+                    unsigned char c = Pattern[i];
+                    t[i * 256 + c] = i + 1;
+                    X = t[X * 256 + c];
+                }
+            }
+        }
+
+        std::array<bool, 256> inLanguage{}, inPattern{};
+        for (int c = 0; c < 256; c++) {
+            inLanguage[c] = Language.contains((char) c);
+            inPattern[c] = Pattern.contains((char) c);
+        }
+
+        for (size_t i = 0; i < nStates; i++) {
+            for (int c = 0; c < 256; c++) {
+                if (i == trap || !inLanguage[c]) {
+                    t[i * 256 + c] = trap;
+                }
+                else if (!inPattern[c]) {
+                    t[i * 256 + c] = i;
+                }
+            }
+        }
+        return t;
+    }
+
+public:
+    static constexpr std::array<Cell, nStates * 256> table = Build();
+
+    static constexpr bool Run(std::string_view input) {
+        int state = 0;
+        for (char c : input) {
+            state = table[state * 256 + (unsigned char) c];
+        }
+        return state == accept;
+    }
+};
+
+// Compile-time DivisibilityAutomaton(Base, Divisor, Digits): state 0 is INIT,
+// state r + 1 is remainder r (state 1 is SOL) and the last state is TERM
+template<int Base, int Divisor,
+         FixedString Digits = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz">
+class StaticDivisibility {
+    static_assert(Base >= 1 && Base <= (int) Digits.size(), "Base needs a digit for every value");
+    static_assert(Divisor >= 1 && Divisor <= 1000, "Compile-time tables are limited to 1000 remainders");
+
+public:
+    static constexpr size_t nStates = Divisor + 2;
+    static constexpr int trap = nStates - 1;
+
+    using Cell = StateCell<nStates>;
+
+private:
+    static constexpr std::array<Cell, nStates * 256> Build() {
+        // Row by row, compilers cap the iterations of a single constexpr loop
+        std::array<Cell, nStates * 256> t{};
+        for (size_t i = 0; i < nStates; i++) {
+            for (int c = 0; c < 256; c++) {
+                t[i * 256 + c] = trap;
+            }
+        }
+
+        for (int d = 0; d < Base; d++) {
+            unsigned char c = Digits[d];
+            t[c] = d % Divisor + 1;
+            for (int r = 0; r < Divisor; r++) {
+                t[(r + 1) * 256 + c] = (Base * r + d) % Divisor + 1;
+            }
+        }
+        return t;
+    }
+
+public:
+    static constexpr std::array<Cell, nStates * 256> table = Build();
+
+    static constexpr bool Run(std::string_view input) {
+        int state = 0;
+        for (char c : input) {
+            state = table[state * 256 + (unsigned char) c];
+        }
+        return state == 1;
+    }
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include<iostream>
+#include<vector>
+#include<cstddef>
+
+// Tracing policy for the automaton runners. A runner takes the tracer as a
+// template parameter and only emits events under
+// `if constexpr (Tracer::enabled)`, so with NullTracer (the default of the
+// plain run methods) the hot loop contains no tracing code at all.
+
+enum TraceKind {
+    TRACE_STEP,       // Consumed 'symbol': from -> to
+    TRACE_EPSILON,    // Epsilon move: from -> to
+    TRACE_TRAP,       // 'symbol' is outside the language, input rejected
+    TRACE_ACCEPT,     // End of input in accepting state 'from'
+    TRACE_REJECT      // End of input (or dead end) in state 'from'
+};
+
+struct TraceEvent {
+    TraceKind kind;
+    size_t pos;        // Input offset of the event
+    char symbol;
+    int from;
+    int to;
+    int stackDepth;    // PDA stack size after the move, -1 for finite automata
+};
+
+// Production policy: compiles to nothing
+struct NullTracer {
+    static constexpr bool enabled = false;
+    void OnEvent(const TraceEvent&) {}
+};
+
+// Keeps the last 'capacity' events (at least one) in a fixed ring, no
+// allocation per event
+class RingBufferTracer {
+    std::vector<TraceEvent> ring;
+    size_t total;
+
+public:
+    static constexpr bool enabled = true;
+
+    RingBufferTracer(size_t capacity = 1024) : ring(capacity > 0 ? capacity : 1), total(0) {}
+
+    void OnEvent(const TraceEvent& e) {
+        ring[total % ring.size()] = e;
+        total++;
+    }
+
+    // Retained events, oldest first
+    std::vector<TraceEvent> Events() const {
+        std::vector<TraceEvent> out;
+        size_t kept = (total < ring.size()) ? total : ring.size();
+        for (size_t i = total - kept; i < total; i++) {
+            out.push_back(ring[i % ring.size()]);
+        }
+        return out;
+    }
+
+    size_t Dropped() const {
+        return (total > ring.size()) ? total - ring.size() : 0;
+    }
+
+    void Clear() {
+        total = 0;
+    }
+};
+
+inline void PrintTraceEvent(std::ostream& out, const TraceEvent& e) {
+    switch (e.kind) {
+        case TRACE_STEP:
+            out << "   [" << e.pos << "] '" << e.symbol << "' : " << e.from << " -> " << e.to;
+            break;
+        case TRACE_EPSILON:
+            out << "   [" << e.pos << "] \u03B5 : " << e.from << " -> " << e.to;  // \u03B5 => ε
+            break;
+        case TRACE_TRAP:
+            out << "   [" << e.pos << "] '" << e.symbol << "' not in language, TRAP";
+            break;
+        case TRACE_ACCEPT:
+            out << "   \u2713 ACCEPTED in state " << e.from;  // \u2713 => ✓
+            break;
+        case TRACE_REJECT:
+            out << "   \u2717 REJECTED in state " << e.from;  // \u2717 => ✗
+            break;
+    }
+    if (e.stackDepth >= 0) out << " (stack " << e.stackDepth << ")";
+    out << "\n";
+}
+
+// Human readable trace on stdout, for the demos
+struct CoutTracer {
+    static constexpr bool enabled = true;
+    void OnEvent(const TraceEvent& e) {
+        PrintTraceEvent(std::cout, e);
+    }
+};
+
+#endif